@@ -7,11 +7,19 @@
 
 #include "config.h"
 
+#include <algorithm>
 #include <functional>
 
+#include <flash_hal.h>
+
+#include "histogram.hpp"
 #include "logger.hpp"
+#include "loop_profiler.hpp"
 #include "projector.hpp"
 #include "power_state.hpp"
+#include "scheduler.hpp"
+#include "state_store.hpp"
+#include "status_cache.hpp"
 
 using std::bind;
 using namespace std::placeholders;
@@ -19,8 +27,15 @@ using namespace std::placeholders;
 // set up logging
 Logger logger;
 
+// every subsystem's timers
+Scheduler scheduler;
+
+// what's kept across reboots, in the first sectors of the filesystem area (see config.h.sample for
+// the flash layout that needs; its size comes from the linker, so it's checked in setup())
+StateStore stateStore(logger, scheduler, FS_PHYS_ADDR / SPI_FLASH_SEC_SIZE, std::min<int>(FS_PHYS_SIZE / SPI_FLASH_SEC_SIZE, STATE_STORE_SECTORS));
+
 BenQProjector projector(
-	logger,
+	logger, scheduler, stateStore,
 	// Serial1 is transmit only, so we send on that, and need to use Serial to receive
 	// (this lets us keep transmitting to a serial console on Serial)
 	Serial, Serial1,
@@ -32,7 +47,7 @@ BenQProjector projector(
 );
 
 PowerState projectorPower(
-	logger, projector,
+	logger, scheduler, projector,
 	10 * 60, // stay on for at least 10 minutes
 	6 * 60 * 60, // power off after 6 hours by default
 	5 * 60, // stay off for at least 5 minutes
@@ -40,13 +55,30 @@ PowerState projectorPower(
 	2 * 60 * 60 // (unless projector has been on for 2 hours already)
 );
 
+// status JSON shared by MQTT and HTTP
+StatusCache status(projector, projectorPower);
+
+// how long each subsystem takes in loop()
+LoopProfiler profiler;
+int projectorSection = profiler.addSection("projector");
+int timersSection = profiler.addSection("timers");
+
+// how long each pass through loop() takes, in microseconds
+static const unsigned long loopTimeBounds[] = { 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000 };
+Histogram<10> loopTime(loopTimeBounds);
+
+// times WiFi has come back after dropping
+long wifiReconnects = 0;
+bool wifiConnected = true;
+
 
 // MQTT setup
 #ifdef ENABLE_MQTT
 
 #include "mqtt.hpp"
 MqttSupport mqtt(
-	logger, projector, projectorPower,
+	logger, projector, projectorPower, status,
+	profiler, scheduler,
 	MQTT_STATUS_INTERVAL,
 	CLIENT_NAME,
 	MQTT_SERVER, MQTT_SERVER_PORT,
@@ -54,8 +86,10 @@ MqttSupport mqtt(
 	MQTT_SET_POWER_TOPIC, MQTT_SET_VOLUME_TOPIC, MQTT_SET_SOURCE_TOPIC, MQTT_SET_LAMP_MODE_TOPIC,
 	MQTT_REMOTE_COMMAND_TOPIC,
 	MQTT_RAW_COMMAND_TOPIC,
-	MQTT_STATUS_TOPIC
+	MQTT_STATUS_TOPIC,
+	MQTT_STATS_TOPIC
 );
+int mqttSection = profiler.addSection("mqtt");
 
 #endif
 
@@ -64,8 +98,12 @@ MqttSupport mqtt(
 #ifdef ENABLE_HTTP
 
 #include "http.hpp"
+#ifdef ENABLE_HTTP_OTA_UPDATE
+#include <Updater.h>
+#endif
 HttpSupport http(
-	logger, projector, projectorPower,
+	logger, projector, projectorPower, status,
+	profiler,
 	HTTP_PORT,
 	#ifdef ENABLE_HTTP_OTA_UPDATE
 		true
@@ -73,6 +111,7 @@ HttpSupport http(
 		false
 	#endif
 );
+int httpSection = profiler.addSection("http");
 
 #endif
 
@@ -82,7 +121,8 @@ HttpSupport http(
 
 
 #include "homekit_support.hpp"
-HomeKitSupport homekit(logger, projector, CLIENT_NAME, HOMEKIT_NAME, NULL);
+HomeKitSupport homekit(logger, projector, projectorPower, CLIENT_NAME, HOMEKIT_NAME, NULL);
+int homekitSection = profiler.addSection("homekit");
 
 #endif
 
@@ -95,7 +135,7 @@ void setup() {
 	Serial1.begin(SERIAL_BAUD_RATE);
 
 	#ifdef SERIAL_LOGGING
-	logger.addListener([](LogEntry entry) {
+	logger.addListener([](const LogEntry &entry) {
 		switch (entry.type) {
 			case DEBUG_LOG: Serial.print("DEBUG "); break;
 			case INFO_LOG:  Serial.print("INFO  "); break;
@@ -105,7 +145,9 @@ void setup() {
 			case COMM_RECV: Serial.print("  <<  "); break;
 		}
 
-		Serial.println(entry.entry.c_str());
+		char line[LOG_LINE_SIZE];
+		entry.format(line, sizeof(line));
+		Serial.println(line);
 	});
 	#endif
 
@@ -120,12 +162,25 @@ void setup() {
 		delay(100);
 	}
 
+	if (FS_PHYS_SIZE < STATE_STORE_SECTORS * SPI_FLASH_SEC_SIZE) {
+		logger.error("Flash layout has %u bytes of filesystem, where keeping state across reboots needs %u; pick a bigger FS (see config.h.sample)",
+			(unsigned)FS_PHYS_SIZE, (unsigned)(STATE_STORE_SECTORS * SPI_FLASH_SEC_SIZE));
+	}
+
 	// projector communication is ready to go
 	projector.begin();
 	projectorPower.begin();
 
 	#ifdef ENABLE_HTTP
 	http.setup();
+
+	#ifdef ENABLE_HTTP_OTA_UPDATE
+	// the update server restarts as soon as the new firmware is in, so anything waiting to be
+	// saved goes out while it's coming in
+	Update.onProgress([](size_t done, size_t total) {
+		stateStore.flush();
+	});
+	#endif
 	#endif
 
 	#ifdef ENABLE_MQTT
@@ -134,26 +189,72 @@ void setup() {
 
 	#ifdef ENABLE_HOMEKIT
 	#ifdef ENABLE_HTTP
-	http.addHomeKitSupport(bind(&HomeKitSupport::getHomeKitPageContent, homekit, _1), bind(&HomeKitSupport::reset, homekit));
+	http.addHomeKitSupport(bind(&HomeKitSupport::getHomeKitPageContent, &homekit, _1), []() {
+		// saved first, since pairing afresh means restarting
+		stateStore.flush();
+		homekit.reset();
+	});
 	#endif
 
 	homekit.setup();
 	#endif
+
+	#ifdef ENABLE_HTTP
+	http.addMetrics([](MetricsWriter &metrics) {
+		metrics.histogram("benq_loop_duration_microseconds", "Time taken by each pass through the main loop.", loopTime);
+		metrics.counter("benq_wifi_reconnects_total", "Times WiFi reconnected after dropping.", wifiReconnects);
+		#ifdef ENABLE_MQTT
+		metrics.counter("benq_mqtt_connections_total", "Times the MQTT broker was connected to, including the first.", mqtt.getConnectionCount());
+		#endif
+		metrics.gauge("benq_state_store_sectors", "Flash sectors the state kept across reboots takes turns over (0 if there's no room for it).", stateStore.getSectorCount());
+		metrics.counter("benq_state_writes_total", "Times the state kept across reboots was written to flash.", stateStore.getWrites());
+		metrics.counter("benq_state_erases_total", "Flash sectors erased to make room for the state kept across reboots.", stateStore.getErases());
+		#ifdef ENABLE_HOMEKIT
+		metrics.counter("benq_homekit_notifications_total", "HomeKit characteristic changes sent to controllers.", homekit.getNotificationCount());
+		#endif
+	});
+	#endif
 }
 
 void loop() {
+	unsigned long loopStart = micros();
+	profiler.begin();
+
+	if (WiFi.isConnected() != wifiConnected) {
+		wifiConnected = !wifiConnected;
+		if (wifiConnected) {
+			wifiReconnects++;
+		}
+	}
+
 	projector.loop();
-	projectorPower.loop();
+	profiler.mark(projectorSection);
 
 	#ifdef ENABLE_HTTP
 	http.loop();
+	profiler.mark(httpSection);
 	#endif
 
 	#ifdef ENABLE_MQTT
 	mqtt.loop();
+	profiler.mark(mqttSection);
 	#endif
 
 	#ifdef ENABLE_HOMEKIT
 	homekit.loop();
+	profiler.mark(homekitSection);
 	#endif
+
+	scheduler.loop();
+	profiler.mark(timersSection);
+
+	profiler.end();
+	loopTime.observe(micros() - loopStart);
+
+	// nothing is due for a bit, so let the WiFi stack have the time (and the radio doze) rather
+	// than spinning
+	unsigned long idle = scheduler.getIdleTime();
+	if (idle > 0) {
+		delay(idle);
+	}
 }
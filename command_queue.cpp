@@ -0,0 +1,181 @@
+#include "command_queue.hpp"
+
+#include <string.h>
+#include <strings.h>
+
+// length of the key part of a command ("pow" for "pow=on", all of it for "menu")
+static int keyLength(const char *command) {
+	const char *equals = strchr(command, '=');
+	return equals != NULL ? equals - command : strlen(command);
+}
+
+static bool isQuery(const char *command) {
+	int keyLen = keyLength(command);
+	return command[keyLen] == '=' && strcmp(command + keyLen + 1, "?") == 0;
+}
+
+CommandQueue::CommandQueue() : duplicatesDropped(0), settersReplaced(0) {
+	const int depths[PRIORITY_COUNT] = { PROJECTOR_INTERACTIVE_QUEUE_DEPTH, PROJECTOR_STATE_QUEUE_DEPTH, PROJECTOR_POLL_QUEUE_DEPTH };
+
+	int first = 0;
+	for (int lane = 0; lane < PRIORITY_COUNT; ++lane) {
+		lanes[lane].first = first;
+		lanes[lane].depth = depths[lane];
+		lanes[lane].head = lanes[lane].count = 0;
+		first += depths[lane];
+	}
+}
+
+char *CommandQueue::slot(int lane, int idx) {
+	// idx never exceeds the depth, so a single wrap is enough (and cheaper than a modulo)
+	idx += lanes[lane].head;
+	if (idx >= lanes[lane].depth) {
+		idx -= lanes[lane].depth;
+	}
+
+	return slots[lanes[lane].first + idx];
+}
+
+int CommandQueue::frontLane() {
+	for (int lane = 0; lane < PRIORITY_COUNT; ++lane) {
+		if (lanes[lane].count > 0) {
+			return lane;
+		}
+	}
+
+	return -1;
+}
+
+void CommandQueue::removeAt(int lane, int idx) {
+	// close the gap; lanes are short, so shuffling the rest forward is cheap
+	for (int i = idx; i < lanes[lane].count - 1; ++i) {
+		strcpy(slot(lane, i), slot(lane, i + 1));
+	}
+
+	lanes[lane].count--;
+}
+
+bool CommandQueue::coalesce(CommandPriority priority, const char *command, CoalesceMode mode) {
+	if (mode == COALESCE_NONE) {
+		return false;
+	}
+
+	int keyLen = keyLength(command);
+	bool query = isQuery(command);
+
+	for (int lane = 0; lane < PRIORITY_COUNT; ++lane) {
+		for (int i = 0; i < lanes[lane].count; ++i) {
+			char *pending = slot(lane, i);
+
+			bool duplicate = mode == COALESCE_DUPLICATE && strcasecmp(pending, command) == 0;
+			bool superseded = mode == COALESCE_REPLACE && !query && !isQuery(pending) &&
+				keyLength(pending) == keyLen && strncasecmp(pending, command, keyLen) == 0;
+
+			if (!duplicate && !superseded) {
+				continue;
+			}
+
+			if (lane <= priority) {
+				// the pending command goes out at least as soon as this one would, so fold this one
+				// into it (keeping its place in line, but sending the newer value)
+				if (superseded) {
+					strcpy(pending, command);
+					settersReplaced++;
+				} else {
+					duplicatesDropped++;
+				}
+
+				return true;
+			}
+
+			if (full(priority)) {
+				// can't move it up, so leave the pending one be
+				return false;
+			}
+
+			// the pending command would go out later than this one, so drop it and let this one
+			// be queued in its place
+			removeAt(lane, i);
+
+			if (superseded) {
+				settersReplaced++;
+			} else {
+				duplicatesDropped++;
+			}
+
+			return false;
+		}
+	}
+
+	return false;
+}
+
+bool CommandQueue::push(CommandPriority priority, const char *raw, CoalesceMode mode) {
+	if (strlen(raw) >= PROJECTOR_COMMAND_SIZE) {
+		return false;
+	}
+
+	if (coalesce(priority, raw, mode)) {
+		return true;
+	}
+
+	if (full(priority)) {
+		return false;
+	}
+
+	strcpy(slot(priority, lanes[priority].count), raw);
+	lanes[priority].count++;
+	return true;
+}
+
+bool CommandQueue::push(CommandPriority priority, const char *key, const char *value, CoalesceMode mode) {
+	size_t keyLen = strlen(key), valueLen = strlen(value);
+
+	if (keyLen + valueLen + 1 >= PROJECTOR_COMMAND_SIZE) {
+		return false;
+	}
+
+	char command[PROJECTOR_COMMAND_SIZE];
+	memcpy(command, key, keyLen);
+	command[keyLen] = '=';
+	memcpy(command + keyLen + 1, value, valueLen + 1);
+
+	return push(priority, command, mode);
+}
+
+const char *CommandQueue::front() {
+	int lane = frontLane();
+	return lane >= 0 ? slot(lane, 0) : NULL;
+}
+
+CommandPriority CommandQueue::frontPriority() {
+	int lane = frontLane();
+	return lane >= 0 ? (CommandPriority)lane : PRIORITY_POLL;
+}
+
+void CommandQueue::pop() {
+	int lane = frontLane();
+
+	if (lane >= 0) {
+		if (++lanes[lane].head == lanes[lane].depth) {
+			lanes[lane].head = 0;
+		}
+		lanes[lane].count--;
+	}
+}
+
+bool CommandQueue::empty() { return frontLane() < 0; }
+bool CommandQueue::full(CommandPriority priority) { return lanes[priority].count == lanes[priority].depth; }
+int CommandQueue::size(CommandPriority priority) { return lanes[priority].count; }
+int CommandQueue::capacity(CommandPriority priority) { return lanes[priority].depth; }
+
+int CommandQueue::size() {
+	int total = 0;
+	for (int lane = 0; lane < PRIORITY_COUNT; ++lane) {
+		total += lanes[lane].count;
+	}
+	return total;
+}
+
+long CommandQueue::getDuplicatesDropped() { return duplicatesDropped; }
+long CommandQueue::getSettersReplaced() { return settersReplaced; }
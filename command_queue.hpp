@@ -0,0 +1,92 @@
+#ifndef COMMAND_QUEUE_HPP
+#define COMMAND_QUEUE_HPP
+
+// default command slot size of 32 bytes, including the null termination
+#define PROJECTOR_COMMAND_SIZE 32
+
+// default lane depths; 32 commands in total
+#define PROJECTOR_INTERACTIVE_QUEUE_DEPTH 16
+#define PROJECTOR_STATE_QUEUE_DEPTH 4
+#define PROJECTOR_POLL_QUEUE_DEPTH 12
+
+/**
+ * Which lane of the queue a command goes in. Lanes are drained strictly in this order, so a
+ * command from a user always goes out next, ahead of anything the power state machine wants, which
+ * in turn goes ahead of background polling.
+ */
+enum CommandPriority {
+	// commands from users (MQTT, HTTP, HomeKit)
+	PRIORITY_INTERACTIVE,
+	// commands the bridge issues on its own (e.g. PowerState's deferred power off)
+	PRIORITY_STATE,
+	// state polling
+	PRIORITY_POLL,
+
+	PRIORITY_COUNT
+};
+
+/**
+ * How a newly queued command interacts with commands that are already pending.
+ */
+enum CoalesceMode {
+	// always queue it (raw commands, remote keys; pressing "up" twice means twice)
+	COALESCE_NONE,
+	// drop it if an identical command is already pending (queries)
+	COALESCE_DUPLICATE,
+	// overwrite a pending setter for the same key in place, so the latest value wins (setters)
+	COALESCE_REPLACE,
+};
+
+/**
+ * Fixed-capacity priority queue of projector commands (the part between the * and #, e.g.
+ * "pow=?"). Every slot is preallocated inline, so queueing and sending commands never touches the
+ * heap; on the ESP8266 that small-object churn fragments the heap over long uptimes. Each priority
+ * lane is its own FIFO with its own depth, so polling can't crowd out commands.
+ *
+ * Commands can be coalesced with what's already pending, which keeps a backed up queue (e.g. while
+ * the projector is warming up) from filling with repeated polls and stale setters. If the pending
+ * command is in a lower priority lane, it's moved up rather than left to go out later.
+ */
+class CommandQueue {
+public:
+
+	CommandQueue();
+
+	// these return false (and queue nothing) if the lane is full or the command is too long; a
+	// command that gets coalesced into a pending one counts as queued
+	bool push(CommandPriority priority, const char *raw, CoalesceMode mode = COALESCE_NONE);
+	bool push(CommandPriority priority, const char *key, const char *value, CoalesceMode mode = COALESCE_NONE);
+
+	// the next command to send (from the highest priority lane); only valid until it is popped
+	const char *front();
+	CommandPriority frontPriority();
+	void pop();
+
+	bool empty();
+	bool full(CommandPriority priority);
+	int size();
+	int size(CommandPriority priority);
+	int capacity(CommandPriority priority);
+
+	long getDuplicatesDropped();
+	long getSettersReplaced();
+
+private:
+
+	char slots[PROJECTOR_INTERACTIVE_QUEUE_DEPTH + PROJECTOR_STATE_QUEUE_DEPTH + PROJECTOR_POLL_QUEUE_DEPTH][PROJECTOR_COMMAND_SIZE];
+
+	// each lane is a ring over its own range of slots
+	struct {
+		int first, depth;
+		int head, count;
+	} lanes[PRIORITY_COUNT];
+
+	long duplicatesDropped, settersReplaced;
+
+	char *slot(int lane, int idx);
+	int frontLane();
+	void removeAt(int lane, int idx);
+	bool coalesce(CommandPriority priority, const char *command, CoalesceMode mode);
+};
+
+#endif
@@ -0,0 +1,218 @@
+#include "config.h"
+#ifdef ENABLE_HTTP
+
+#include "event_stream.hpp"
+
+#include <ArduinoJson.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <Arduino.h>
+
+EventStream::EventStream(Logger &logger, BenQProjector &projector, PowerState &projectorPower, StatusCache &status) :
+	logger(logger), projector(projector), projectorPower(projectorPower), status(status),
+	subscriberCount(0), dropped(0), droppedLogged(0), sent(), statusChanged(false), lastKeepAlive(0) {
+
+	logger.addListener([this](const LogEntry &entry) {
+		logged(entry);
+	});
+
+	status.addChangeListener([this]() {
+		statusChanged = true;
+	});
+}
+
+bool EventStream::subscribe(WiFiClient client) {
+	int slot = 0;
+	while (slot < EVENT_STREAM_SUBSCRIBERS && subscribers[slot].active) {
+		slot++;
+	}
+	if (slot == EVENT_STREAM_SUBSCRIBERS) {
+		return false;
+	}
+
+	if (subscriberCount == 0) {
+		// nothing's been keeping track while nobody was listening
+		readFields(sent);
+		statusChanged = false;
+	}
+
+	subscribers[slot].client = client;
+	subscribers[slot].active = true;
+	subscriberCount++;
+
+	// the server would send a body chunked, but this one is written to the connection directly
+	static const char header[] =
+		"HTTP/1.1 200 OK\r\n"
+		"Content-Type: text/event-stream\r\n"
+		"Cache-Control: no-cache\r\n"
+		"Connection: keep-alive\r\n"
+		"\r\n";
+	client.setNoDelay(true);
+	send(header, sizeof(header) - 1, &subscribers[slot]);
+
+	sendStatus(true, &subscribers[slot]);
+	return true;
+}
+
+void EventStream::loop() {
+	if (subscriberCount == 0) {
+		return;
+	}
+
+	if (statusChanged) {
+		statusChanged = false;
+		sendStatus(false, NULL);
+	}
+
+	if (millis() - lastKeepAlive >= EVENT_STREAM_KEEPALIVE) {
+		// a comment line, which EventSource ignores
+		static const char keepAlive[] = ": keep-alive\n\n";
+		send(keepAlive, sizeof(keepAlive) - 1);
+		lastKeepAlive = millis();
+	}
+
+	for (int slot = 0; slot < EVENT_STREAM_SUBSCRIBERS; ++slot) {
+		if (subscribers[slot].active && !subscribers[slot].client.connected()) {
+			drop(slot);
+		}
+	}
+
+	if (dropped != droppedLogged) {
+		// (not logged as it happens, since that's usually in the middle of sending a log event)
+		logger.info("Dropped %ld /events client(s) that fell too far behind", dropped - droppedLogged);
+		droppedLogged = dropped;
+	}
+}
+
+void EventStream::readFields(Fields &fields) {
+	auto projectorState = projector.getSnapshot();
+
+	fields.power = projectorPower.getSnapshot().virtualPowerState;
+	fields.status = projectorState.statusStr;
+	strncpy(fields.model, projectorState.modelName, sizeof(fields.model) - 1);
+	strncpy(fields.source, projectorState.source, sizeof(fields.source) - 1);
+	fields.volume = projectorState.volume;
+	fields.muted = projectorState.isMuted;
+	strncpy(fields.lampMode, projectorState.lampMode, sizeof(fields.lampMode) - 1);
+	fields.lampHours = projectorState.lampHours;
+	fields.blank = projectorState.isImageBlanked;
+	fields.freeze = projectorState.isImageFrozen;
+	fields.transition = projectorState.transition;
+	fields.eta = projectorState.transitionEta;
+}
+
+void EventStream::sendStatus(bool everything, Subscriber *only) {
+	Fields current = Fields();
+	readFields(current);
+
+	StaticJsonDocument<EVENT_STREAM_EVENT_SIZE> changed;
+	if (everything || current.power != sent.power) changed["power"] = current.power;
+	if (everything || strcmp(current.status, sent.status != NULL ? sent.status : "") != 0) changed["status"] = current.status;
+	if (everything || strcmp(current.model, sent.model) != 0) changed["model"] = current.model;
+	if (everything || strcmp(current.source, sent.source) != 0) changed["source"] = current.source;
+	if (everything || current.volume != sent.volume) changed["volume"] = current.volume;
+	if (everything || current.muted != sent.muted) changed["muted"] = current.muted;
+	if (everything || strcmp(current.lampMode, sent.lampMode) != 0) changed["lamp_mode"] = current.lampMode;
+	if (everything || current.lampHours != sent.lampHours) changed["lamp_hours"] = current.lampHours;
+	if (everything || current.blank != sent.blank) changed["blank"] = current.blank;
+	if (everything || current.freeze != sent.freeze) changed["freeze"] = current.freeze;
+	if (everything || current.transition != sent.transition) changed["transition"] = current.transition;
+	if (everything || current.eta != sent.eta) {
+		// in seconds, or null when there's no transition or we don't know how long it takes
+		if (current.eta >= 0) {
+			changed["eta"] = current.eta / 1000;
+		} else {
+			changed["eta"] = nullptr;
+		}
+	}
+
+	if (!everything) {
+		sent = current;
+	}
+
+	if (changed.size() == 0) {
+		// the version moved, but nothing shown here did
+		return;
+	}
+
+	char event[EVENT_STREAM_EVENT_SIZE];
+	size_t len = snprintf(event, sizeof(event), "event: status\ndata: ");
+	len += serializeJson(changed, event + len, sizeof(event) - len - 2);
+	event[len++] = '\n';
+	event[len++] = '\n';
+
+	send(event, len, only);
+}
+
+void EventStream::logged(const LogEntry &entry) {
+	if (subscriberCount == 0) {
+		return;
+	}
+
+	const char *prefix = "";
+	switch (entry.type) {
+		case DEBUG_LOG: prefix = "DEBUG "; break;
+		case INFO_LOG:  prefix = "INFO  "; break;
+		case ERROR_LOG: prefix = "ERROR "; break;
+		case COMM_SENT: prefix = "  >>  "; break;
+		case COMM_ECHO: prefix = "  <>  "; break;
+		case COMM_RECV: prefix = "  <<  "; break;
+	}
+
+	char line[LOG_LINE_SIZE];
+	entry.format(line, sizeof(line));
+	// a line break would end the data field early, and whatever follows (e.g. from a raw command)
+	// would be read as fields of its own
+	for (char *c = line; *c != 0; ++c) {
+		if (*c == '\r' || *c == '\n') {
+			*c = ' ';
+		}
+	}
+
+	char event[EVENT_STREAM_EVENT_SIZE];
+	int len = snprintf(event, sizeof(event), "event: log\ndata: %s%s\n\n", prefix, line);
+	if (len > 0 && (size_t)len < sizeof(event)) {
+		send(event, len);
+	}
+}
+
+void EventStream::send(const char *event, size_t len, Subscriber *only) {
+	for (int slot = 0; slot < EVENT_STREAM_SUBSCRIBERS; ++slot) {
+		if (!subscribers[slot].active || (only != NULL && only != &subscribers[slot])) {
+			continue;
+		}
+
+		WiFiClient &client = subscribers[slot].client;
+		if (!client.connected()) {
+			drop(slot);
+			continue;
+		}
+
+		// a write that doesn't fit would wait for the client to catch up; it goes instead
+		if (client.availableForWrite() < len) {
+			dropped++;
+			drop(slot);
+			continue;
+		}
+
+		client.write((const uint8_t *)event, len);
+	}
+}
+
+void EventStream::drop(int slot) {
+	subscribers[slot].client.stop();
+	subscribers[slot].client = WiFiClient();
+	subscribers[slot].active = false;
+	subscriberCount--;
+}
+
+int EventStream::getSubscriberCount() {
+	return subscriberCount;
+}
+
+long EventStream::getDroppedCount() {
+	return dropped;
+}
+
+#endif
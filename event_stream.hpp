@@ -0,0 +1,83 @@
+#ifndef EVENT_STREAM_HPP
+#define EVENT_STREAM_HPP
+
+// default of 2 clients listening to /events at once; more than that are turned away
+#define EVENT_STREAM_SUBSCRIBERS 2
+
+// default of a keep-alive comment every 15 seconds, which also finds clients that have gone away
+#define EVENT_STREAM_KEEPALIVE 15000
+
+// largest single event (including its event: and data: lines)
+#define EVENT_STREAM_EVENT_SIZE 256
+
+#include "logger.hpp"
+#include "projector.hpp"
+#include "power_state.hpp"
+#include "status_cache.hpp"
+
+#include <WiFiClient.h>
+
+/**
+ * Server-sent events for /events: a `status` event with whatever changed whenever the projector's
+ * or our power state moves on (a new subscriber gets all of it first), and a `log` event for every
+ * entry logged.
+ *
+ * Events are written straight to each subscriber's connection, and nothing here ever waits on a
+ * client. One that's too far behind to take a whole event without blocking is dropped; it can
+ * always reconnect, and EventSource in a browser does so on its own.
+ */
+class EventStream {
+public:
+
+	EventStream(Logger &logger, BenQProjector &projector, PowerState &projectorPower, StatusCache &status);
+
+	// takes over a connection whose request has been read; false if there's no room for it
+	bool subscribe(WiFiClient client);
+
+	void loop();
+
+	int getSubscriberCount();
+	long getDroppedCount();
+
+private:
+
+	// the status fields, as last sent, to work out what's changed
+	struct Fields {
+		bool power;
+		const char *status;
+		char model[32];
+		char source[16];
+		int volume;
+		bool muted;
+		char lampMode[8];
+		int lampHours;
+		bool blank, freeze;
+		const char *transition;
+		long eta;
+	};
+
+	Logger &logger;
+	BenQProjector &projector;
+	PowerState &projectorPower;
+	StatusCache &status;
+
+	struct Subscriber {
+		WiFiClient client;
+		bool active = false;
+	} subscribers[EVENT_STREAM_SUBSCRIBERS];
+	int subscriberCount;
+	long dropped, droppedLogged;
+
+	Fields sent;
+	// the status has moved on since it was last sent
+	bool statusChanged;
+	unsigned long lastKeepAlive;
+
+	void readFields(Fields &fields);
+	void logged(const LogEntry &entry);
+	void sendStatus(bool everything, Subscriber *only);
+	void send(const char *event, size_t len, Subscriber *only = NULL);
+	void drop(int slot);
+};
+
+#endif
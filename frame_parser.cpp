@@ -0,0 +1,135 @@
+#include "frame_parser.hpp"
+
+FrameParser::FrameParser() : state(STATE_START), idx(0), current() {
+}
+
+bool FrameParser::pushDelimiter(char c) {
+	if (c == '\r' || c == '\n') {
+		return endLine(c);
+	}
+
+	if (state == STATE_OVERFLOW) {
+		return false;
+	}
+
+	if (idx == PROJECTOR_RECV_BUFFER_SIZE) {
+		// keep what we have so the start of it can be logged, and dump the rest
+		state = STATE_OVERFLOW;
+		return false;
+	}
+
+	data[idx++] = c;
+
+	switch (state) {
+		case STATE_AFTER_CR:
+		case STATE_START:
+			current.hasValue = false;
+			current.value = "";
+			current.valueLen = 0;
+			current.error = NULL;
+
+			if (c == '>') {
+				// projector echoes commands back prefixed with a > character
+				current.type = FRAME_ECHO;
+				state = STATE_ECHO;
+			} else if (c == '*') {
+				current.type = FRAME_MESSAGE;
+				current.body = current.key = data + idx;
+				state = STATE_KEY;
+			} else {
+				malformed("Received message didn't start with '*'; gibberish?");
+			}
+			break;
+
+		case STATE_ECHO:
+			if (c == '*') {
+				current.body = current.key = data + idx;
+				state = STATE_KEY;
+			} else {
+				malformed("Received echo didn't start with '>*'; gibberish?");
+			}
+			break;
+
+		case STATE_KEY:
+			// the key ends with an = or a # (if there is no value)
+			if (c == '=') {
+				current.keyLen = data + idx - 1 - current.key;
+				current.hasValue = true;
+				current.value = data + idx;
+				state = STATE_VALUE;
+			} else if (c == '#') {
+				current.keyLen = current.bodyLen = data + idx - 1 - current.key;
+				state = STATE_END;
+			}
+			break;
+
+		case STATE_VALUE:
+			if (c == '#') {
+				current.valueLen = data + idx - 1 - current.value;
+				current.bodyLen = data + idx - 1 - current.body;
+				state = STATE_END;
+			}
+			break;
+
+		case STATE_END:
+		case STATE_MALFORMED:
+		case STATE_OVERFLOW:
+			break;
+	}
+
+	return false;
+}
+
+bool FrameParser::endLine(char c) {
+	State ended = state;
+	state = c == '\r' ? STATE_AFTER_CR : STATE_START;
+
+	if (ended == STATE_AFTER_CR && c == '\n') {
+		// the second half of a \r\n
+		state = STATE_START;
+		return false;
+	}
+
+	if (idx == 0 && ended != STATE_OVERFLOW) {
+		// nothing but a line ending
+		return false;
+	}
+
+	data[idx] = 0;
+	current.line = data;
+	current.lineLen = idx;
+	idx = 0;
+
+	switch (ended) {
+		case STATE_ECHO:
+			current.type = FRAME_MALFORMED;
+			current.error = "Received echo didn't start with '>*'; gibberish?";
+			break;
+		case STATE_KEY:
+			current.type = FRAME_MALFORMED;
+			current.error = "Was expecting '=' or '#', message cut short?";
+			break;
+		case STATE_VALUE:
+			current.type = FRAME_MALFORMED;
+			current.error = "Was expecting '#', message cut short?";
+			break;
+		case STATE_OVERFLOW:
+			current.type = FRAME_OVERFLOW;
+			break;
+		default:
+			// finished frames and already malformed ones are ready as they are
+			break;
+	}
+
+	return true;
+}
+
+void FrameParser::malformed(const char *error) {
+	current.type = FRAME_MALFORMED;
+	current.error = error;
+	state = STATE_MALFORMED;
+}
+
+const Frame &FrameParser::frame() {
+	return current;
+}
@@ -0,0 +1,107 @@
+#ifndef FRAME_PARSER_HPP
+#define FRAME_PARSER_HPP
+
+#include <stddef.h>
+
+// default buffer size of 64 bytes
+#define PROJECTOR_RECV_BUFFER_SIZE 64
+
+/**
+ * What a complete line from the projector turned out to be.
+ */
+enum FrameType {
+	// >*command#; the projector echoing back what we sent
+	FRAME_ECHO,
+	// *key=value# or *key#; an answer (errors such as *Block item# come as a key without a value)
+	FRAME_MESSAGE,
+	// didn't look like either of those; see Frame::error
+	FRAME_MALFORMED,
+	// didn't fit in the receive buffer, so only the beginning was kept
+	FRAME_OVERFLOW,
+};
+
+/**
+ * A complete line, tokenized. The line itself is a null-terminated string in the parser's buffer;
+ * body, key and value are views into it (NOT null-terminated), so everything here is only valid
+ * until the next byte is pushed.
+ */
+struct Frame {
+	FrameType type;
+
+	// the whole line minus its terminator, e.g. "*POW=ON#"
+	const char *line;
+	size_t lineLen;
+
+	// echoes and messages only: everything between the * and the #, e.g. POW=ON
+	const char *body;
+	size_t bodyLen;
+
+	const char *key;
+	size_t keyLen;
+
+	bool hasValue;
+	const char *value;
+	size_t valueLen;
+
+	// malformed frames only: what was wrong with it
+	const char *error;
+};
+
+/**
+ * Single-pass parser for the projector's side of the RS232 link. Bytes are pushed in as they're
+ * read; the parser stores each one once and tokenizes the `>*key=value#` and `*key=value#` frames
+ * as it goes, so there's no second pass over the line and nothing gets copied out of it.
+ *
+ * The spec says lines end with \r, but my projector sends \r\n; \r, \n and \r\n are all taken as
+ * one line ending, and empty lines are skipped.
+ */
+class FrameParser {
+public:
+
+	FrameParser();
+
+	// returns true if this byte completed a frame, which is then available from frame()
+	bool push(char c) {
+		// this runs for every byte received, so most of them (the ones in the middle of a key or
+		// value) are just stored right here
+		if ((state == STATE_KEY || state == STATE_VALUE) && idx < PROJECTOR_RECV_BUFFER_SIZE &&
+			c != '=' && c != '#' && c != '\r' && c != '\n') {
+			data[idx++] = c;
+			return false;
+		}
+
+		return pushDelimiter(c);
+	}
+
+	const Frame &frame();
+
+private:
+
+	enum State {
+		// at the start of a line, nothing read yet
+		STATE_START,
+		// just read the \r ending a line; a \n right after it belongs to that line ending
+		STATE_AFTER_CR,
+		// read the > of an echo, the * comes next
+		STATE_ECHO,
+		STATE_KEY,
+		STATE_VALUE,
+		// read the closing #; anything after it up to the line ending is ignored
+		STATE_END,
+		// something was wrong; skip to the end of the line
+		STATE_MALFORMED,
+		// out of buffer; skip to the end of the line
+		STATE_OVERFLOW,
+	};
+
+	State state;
+	char data[PROJECTOR_RECV_BUFFER_SIZE + 1];
+	size_t idx;
+	Frame current;
+
+	bool pushDelimiter(char c);
+	bool endLine(char c);
+	void malformed(const char *error);
+};
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef HISTOGRAM_HPP
+#define HISTOGRAM_HPP
+
+#include <stddef.h>
+
+/**
+ * Counts of observed values in N fixed buckets (plus one for everything above the last bound), the
+ * way Prometheus histograms want them. Observing is a short scan of the bounds and an increment,
+ * with nothing allocated.
+ *
+ * The bounds are ascending upper limits (inclusive) and have to outlive the histogram, e.g.:
+ *
+ *     static const unsigned long latencyBounds[] = { 10, 20, 50, 100 };
+ *     Histogram<4> latency(latencyBounds);
+ */
+template<size_t N> class Histogram {
+public:
+
+	explicit Histogram(const unsigned long (&bounds)[N]) : bounds(bounds), buckets(), count(0), sum(0) {
+	}
+
+	void observe(unsigned long value) {
+		size_t bucket = 0;
+		while (bucket < N && value > bounds[bucket]) {
+			bucket++;
+		}
+
+		buckets[bucket]++;
+		count++;
+		sum += value;
+	}
+
+	static constexpr size_t getBucketCount() {
+		return N;
+	}
+
+	unsigned long getBound(size_t bucket) const {
+		return bounds[bucket];
+	}
+
+	// observations no greater than getBound(bucket), or all of them for bucket N
+	unsigned long getCumulativeCount(size_t bucket) const {
+		unsigned long total = 0;
+		for (size_t i = 0; i <= bucket && i <= N; ++i) {
+			total += buckets[i];
+		}
+		return total;
+	}
+
+	unsigned long getCount() const {
+		return count;
+	}
+
+	unsigned long long getSum() const {
+		return sum;
+	}
+
+private:
+
+	const unsigned long (&bounds)[N];
+	unsigned long buckets[N + 1];
+	unsigned long count;
+	unsigned long long sum;
+};
+
+#endif
@@ -7,7 +7,7 @@
 // Accessories must increment the config number after a firmware update.
 // This must have a range of 1-65535 and wrap to 1 when it overflows.
 // This value must persist across reboots, power cycles, etc.
-#define HOMEKIT_CONFIG_NUMBER 1
+#define HOMEKIT_CONFIG_NUMBER 2
 
 
 #include "version.h"
@@ -58,7 +58,11 @@ homekit_accessory_t *hkAccessories[] = {
 			NULL
 		}),
 		HOMEKIT_SERVICE(TELEVISION, .primary = true, .characteristics = (homekit_characteristic_t*[]) {
-
+			&hkTelevisionName,
+			&hkTelevisionIsActive,
+			&hkTelevisionActiveInput,
+			&hkRemote,
+			HOMEKIT_CHARACTERISTIC(SLEEP_DISCOVERY_MODE, HOMEKIT_SLEEP_DISCOVERY_MODE_ALWAYS_DISCOVERABLE),
 			NULL
 		}, .linked = (homekit_characteristic_t*[]) {
 			&hkTvInputs[0],
@@ -31,8 +31,17 @@ extern "C" {
 
 using namespace std;
 
-HomeKitSupport::HomeKitSupport(Logger &logger, BenQProjector &projector, const char *clientName, const char *homeKitName, const char *setupCode)
-	: logger(logger), projector(projector) {	
+// the projector source behind each of the inputs defined in homekit_accessory.c
+static const struct {
+	uint32_t identifier;
+	const char *source;
+} inputs[] = {
+	{ 10, "hdmi" },
+};
+
+HomeKitSupport::HomeKitSupport(Logger &logger, BenQProjector &projector, PowerState &projectorPower, const char *clientName, const char *homeKitName, const char *setupCode)
+	: logger(logger), projector(projector), projectorPower(projectorPower),
+	activeChanged(true), inputChanged(true), notifications(0) {
 
 	if (setupCode != NULL) {
 		strcpy(this->setupCode, setupCode);
@@ -51,75 +60,124 @@ HomeKitSupport::HomeKitSupport(Logger &logger, BenQProjector &projector, const c
 	};
 
 	hkTelevisionName.value.string_value = (char *)homeKitName;
-	hkTelevisionIsActive.value.bool_value = false;
-	hkTelevisionActiveInput.value.uint32_value = 10;
+	hkTelevisionIsActive.value.uint8_value = 0;
+	hkTelevisionActiveInput.value.uint32_value = inputs[0].identifier;
 
+	// (the library leaves the value alone when there's a setter; we set it to what was asked for,
+	// and it's put right after the next change if that doesn't happen)
+	hkTelevisionIsActive.setter = [](const homekit_value_t value) {
+		::homekit.setActive(value.uint8_value != 0);
+	};
+	hkTelevisionActiveInput.setter = [](const homekit_value_t value) {
+		::homekit.setActiveInput(value.uint32_value);
+	};
 	hkRemote.setter = [](const homekit_value_t value) {
-		switch (value.uint8_value) {
-			case HOMEKIT_REMOTE_KEY_REWIND:
-				::homekit.logger.debug("HKREMOTE: REWIND");
-				break;
-
-			case HOMEKIT_REMOTE_KEY_FAST_FORWARD:
-				::homekit.logger.debug("HKREMOTE: FAST FORWARD");
-				break;
+		::homekit.remoteKeyPressed(value.uint8_value);
+	};
 
-			case HOMEKIT_REMOTE_KEY_NEXT_TRACK:
-				::homekit.logger.debug("HKREMOTE: NEXT TRACK");
-				break;
+	hkTvInputVisibilities[0].value.uint8_value = HOMEKIT_CURRENT_VISIBILITY_STATE_SHOWN;
+}
 
-			case HOMEKIT_REMOTE_KEY_PREVIOUS_TRACK:
-				::homekit.logger.debug("HKREMOTE: PREVIOUS TRACK");
-				break;
+void HomeKitSupport::setup() {
+	projector.addChangeListener([this](const ProjectorChange &change) {
+		if (change.field == FIELD_POWER) {
+			activeChanged = true;
+		} else if (change.field == FIELD_SOURCE) {
+			inputChanged = true;
+		}
+	});
+	projectorPower.addChangeListener([this]() {
+		// a virtual off (or undoing one) moves Active without the projector doing anything
+		activeChanged = true;
+	});
 
-			case HOMEKIT_REMOTE_KEY_ARROW_UP:
-				::homekit.logger.debug("HKREMOTE: UP");
-				break;
+	// all global-y. yuck.
+	arduino_homekit_setup(&hkConfig);
+}
 
-			case HOMEKIT_REMOTE_KEY_ARROW_DOWN:
-				::homekit.logger.debug("HKREMOTE: DOWN");
-				break;
+void HomeKitSupport::loop() {
+	// (not from the listeners themselves, since those can run in the middle of one of our setters)
+	updateCharacteristics();
 
-			case HOMEKIT_REMOTE_KEY_ARROW_LEFT:
-				::homekit.logger.debug("HKREMOTE: LEFT");
-				break;
+	arduino_homekit_loop();
+}
 
-			case HOMEKIT_REMOTE_KEY_ARROW_RIGHT:
-				::homekit.logger.debug("HKREMOTE: RIGHT");
-				break;
+void HomeKitSupport::updateCharacteristics() {
+	if (activeChanged) {
+		activeChanged = false;
 
-			case HOMEKIT_REMOTE_KEY_SELECT:
-				::homekit.logger.debug("HKREMOTE: SELECT");
-				break;
+		uint8_t active = projectorPower.getVirtualPowerState() ? 1 : 0;
+		if (hkTelevisionIsActive.value.uint8_value != active) {
+			hkTelevisionIsActive.value.uint8_value = active;
+			homekit_characteristic_notify(&hkTelevisionIsActive, hkTelevisionIsActive.value);
+			notifications++;
+		}
+	}
 
-			case HOMEKIT_REMOTE_KEY_BACK:
-				::homekit.logger.debug("HKREMOTE: BACK");
+	if (inputChanged) {
+		inputChanged = false;
+
+		// a source with no input of its own (or "none", while off) leaves the last one selected
+		for (auto &input : inputs) {
+			if (strcasecmp(input.source, projector.getSource()) == 0) {
+				if (hkTelevisionActiveInput.value.uint32_value != input.identifier) {
+					hkTelevisionActiveInput.value.uint32_value = input.identifier;
+					homekit_characteristic_notify(&hkTelevisionActiveInput, hkTelevisionActiveInput.value);
+					notifications++;
+				}
 				break;
+			}
+		}
+	}
+}
 
-			case HOMEKIT_REMOTE_KEY_EXIT:
-				::homekit.logger.debug("HKREMOTE: EXIT");
-				break;
+void HomeKitSupport::setActive(bool active) {
+	hkTelevisionIsActive.value.uint8_value = active ? 1 : 0;
 
-			case HOMEKIT_REMOTE_KEY_PLAY_PAUSE:
-				::homekit.logger.debug("HKREMOTE: PLAY/PAUSE");
-				break;
+	if (active) {
+		if (!projectorPower.requestPowerOn()) {
+			logger.info("HomeKit asked for power on, but the projector can't be turned on right now");
+			// so tell the controller it's still off
+			activeChanged = true;
+		}
+	} else {
+		projectorPower.requestPowerOff();
+	}
+}
 
-			case HOMEKIT_REMOTE_KEY_INFORMATION:
-				::homekit.logger.debug("HKREMOTE: INFORMATION");
-				break;
+void HomeKitSupport::setActiveInput(uint32_t identifier) {
+	for (auto &input : inputs) {
+		if (input.identifier == identifier) {
+			hkTelevisionActiveInput.value.uint32_value = identifier;
+			projector.setSource(input.source);
+			return;
 		}
-	};
+	}
 
-	hkTvInputVisibilities[0].value.uint8_value = HOMEKIT_CURRENT_VISIBILITY_STATE_SHOWN;
+	logger.error("HomeKit asked for unknown input %u", identifier);
+	inputChanged = true;
 }
 
-void HomeKitSupport::setup() {
-	// all global-y. yuck.
-	arduino_homekit_setup(&hkConfig);
-}
+void HomeKitSupport::remoteKeyPressed(uint8_t remoteKey) {
+	const char *key;
+	switch (remoteKey) {
+		case HOMEKIT_REMOTE_KEY_ARROW_UP: key = "UP"; break;
+		case HOMEKIT_REMOTE_KEY_ARROW_DOWN: key = "DOWN"; break;
+		case HOMEKIT_REMOTE_KEY_ARROW_LEFT: key = "LEFT"; break;
+		case HOMEKIT_REMOTE_KEY_ARROW_RIGHT: key = "RIGHT"; break;
+		case HOMEKIT_REMOTE_KEY_SELECT: key = "SELECT"; break;
+		// both close the menu
+		case HOMEKIT_REMOTE_KEY_BACK: key = "BACK"; break;
+		case HOMEKIT_REMOTE_KEY_EXIT: key = "BACK"; break;
+		case HOMEKIT_REMOTE_KEY_INFORMATION: key = "INFO"; break;
+		default:
+			// rewind, play/pause and the like; there's nothing on the projector for those
+			logger.debug("HKREMOTE: ignoring key %d", remoteKey);
+			return;
+	}
 
-void HomeKitSupport::loop() {
-	arduino_homekit_loop();
+	logger.debug("HKREMOTE: %s", key);
+	projector.sendRemoteKey(key);
 }
 
 void HomeKitSupport::reset() {
@@ -140,6 +198,7 @@ string HomeKitSupport::getHomeKitPageContent(string resetUrl) {
 		<< "		<h2>HomeKit Status</h2>" << endl
 		<< "		<div>Status: " << (arduino_homekit_get_running_server()->paired ? "PAIRED" : "NOT PAIRED") << "</div>" << endl
 		<< "		<div>Client Count: " << arduino_homekit_connected_clients_count() << "</div>" << endl
+		<< "		<div>Notifications Sent: " << notifications << "</div>" << endl
 		<< "		<div><form method=\"POST\" action=\"" << resetUrl << "\"><input type=\"submit\" value=\"Reset HomeKit\" />(will unpair existing device)</form></div>" << endl
 		<< "	</body>" << endl
 		<< "</html>";
@@ -151,4 +210,8 @@ const char *HomeKitSupport::getSetupCode() {
 	return setupCode;
 }
 
+long HomeKitSupport::getNotificationCount() {
+	return notifications;
+}
+
 #endif
\ No newline at end of file
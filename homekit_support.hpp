@@ -3,6 +3,7 @@
 
 #include "logger.hpp"
 #include "projector.hpp"
+#include "power_state.hpp"
 
 #include <string>
 
@@ -16,12 +17,18 @@
  * Not that anyone reading this probably cares, but this class is intended to be a singleton; there
  * are some assumptions made internally about that (referencing the `homekit` extern that's defined
  * below). This mostly comes back to the very C/global nature of Ardiuno HomeKit.
+ *
+ * Controllers are told about Active (our virtual power state) and the active input as they change,
+ * so they never have to poll us; each is compared against what was last sent after any change that
+ * could move it, and only notified if it's different. Writes to Active, the active input and the
+ * remote go straight to the projector as interactive commands (power through PowerState, like
+ * everything else).
  */
 class HomeKitSupport {
 public:
 
 	HomeKitSupport(
-		Logger &logger, BenQProjector &projector,
+		Logger &logger, BenQProjector &projector, PowerState &projectorPower,
 		const char *clientName, const char *homeKitName,
 		const char *setupCode
 	);
@@ -35,10 +42,23 @@ public:
 
 	const char *getSetupCode();
 
+	// characteristic changes sent to controllers
+	long getNotificationCount();
+
 private:
 
 	Logger &logger;
 	BenQProjector &projector;
+	PowerState &projectorPower;
+
+	// something changed that could move Active or the active input since they were last compared
+	bool activeChanged, inputChanged;
+	long notifications;
+
+	void updateCharacteristics();
+	void setActive(bool active);
+	void setActiveInput(uint32_t identifier);
+	void remoteKeyPressed(uint8_t remoteKey);
 	char serialNumber[9] = "";
 	char setupCode[11] = "";
 };
@@ -0,0 +1,51 @@
+#include "alloc_counter.hpp"
+
+#include <cstdlib>
+#include <malloc.h>
+#include <new>
+
+static long allocationCount = 0;
+static size_t allocatedBytes = 0;
+static size_t liveBytes = 0;
+static size_t peakLiveBytes = 0;
+
+namespace host {
+	long getAllocationCount() { return allocationCount; }
+	size_t getAllocatedBytes() { return allocatedBytes; }
+
+	size_t getLiveBytes() { return liveBytes; }
+	size_t getPeakLiveBytes() { return peakLiveBytes; }
+	void resetPeakLiveBytes() { peakLiveBytes = liveBytes; }
+}
+
+void *operator new(size_t size) {
+	allocationCount++;
+	allocatedBytes += size;
+
+	void *ptr = malloc(size == 0 ? 1 : size);
+	if (ptr == nullptr) {
+		throw std::bad_alloc();
+	}
+
+	// what malloc actually handed out, so that delete can take back the same amount
+	liveBytes += malloc_usable_size(ptr);
+	if (liveBytes > peakLiveBytes) {
+		peakLiveBytes = liveBytes;
+	}
+	return ptr;
+}
+
+void *operator new[](size_t size) {
+	return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept {
+	if (ptr != nullptr) {
+		liveBytes -= malloc_usable_size(ptr);
+	}
+	free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept { operator delete(ptr); }
+void operator delete(void *ptr, size_t) noexcept { operator delete(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { operator delete(ptr); }
@@ -0,0 +1,21 @@
+#ifndef ALLOC_COUNTER_HPP
+#define ALLOC_COUNTER_HPP
+
+#include <cstddef>
+
+/**
+ * Counts every heap allocation made through operator new (the host build replaces the global
+ * operator new/delete to do this), so host programs can check that a code path doesn't allocate.
+ * It also keeps track of how much is allocated at any one time, and the most there has been since
+ * resetPeakLiveBytes(), so they can check how much heap a code path needs.
+ */
+namespace host {
+	long getAllocationCount();
+	size_t getAllocatedBytes();
+
+	size_t getLiveBytes();
+	size_t getPeakLiveBytes();
+	void resetPeakLiveBytes();
+}
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include "alloc_counter.hpp"
+
+#include <chrono>
+#include <cstdio>
+
+/**
+ * Tiny benchmark helper for the host build: runs `fn` `iterations` times and prints the mean host
+ * CPU time and heap allocations per iteration.
+ */
+template<typename Fn> double bench(const char *name, long iterations, Fn fn) {
+	// warm up caches (and anything lazily allocated) first
+	for (long i = 0; i < iterations / 10 + 1; ++i) {
+		fn();
+	}
+
+	long allocations = host::getAllocationCount();
+	auto start = std::chrono::steady_clock::now();
+
+	for (long i = 0; i < iterations; ++i) {
+		fn();
+	}
+
+	auto end = std::chrono::steady_clock::now();
+	allocations = host::getAllocationCount() - allocations;
+
+	double nanos = std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+	printf("  %-48s %9.1f ns/op %8.2f allocs/op\n", name, nanos, (double)allocations / iterations);
+	return nanos;
+}
+
+// keeps the optimizer from throwing away a benchmark's work
+template<typename T> inline void doNotOptimize(T const &value) {
+	asm volatile("" : : "r,m"(value) : "memory");
+}
+
+#endif
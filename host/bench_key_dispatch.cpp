@@ -0,0 +1,91 @@
+/** Key dispatch microbenchmark.
+ * Compares the old strcasecmp chain BenQProjector::receiveValue used to pick a handler with a
+ * KeyTable lookup over the same keys, on one poll cycle's worth of replies (upper-case, as the
+ * projector sends them) plus a few keys neither of them knows.
+ */
+
+#include <cstdio>
+#include <strings.h>
+
+#include "bench.hpp"
+#include "key_table.hpp"
+
+static const char *replyKeys[] = {
+	"POW", "SOUR", "VOL", "MUTE", "LAMPM", "BLANK", "FREEZE", "LTIM", "MODELNAME",
+	"MENU", "ENTER", "3D",
+};
+
+// the chain receiveValue used to run, returning which branch matched
+static int legacyDispatch(const char *key) {
+	if (strcasecmp(key, "pow") == 0) {
+		return 0;
+	} else if (strcasecmp(key, "sour") == 0) {
+		return 1;
+	} else if (strcasecmp(key, "mute") == 0) {
+		return 2;
+	} else if (strcasecmp(key, "vol") == 0) {
+		return 3;
+	} else if (strcasecmp(key, "lampm") == 0) {
+		return 4;
+	} else if (strcasecmp(key, "blank") == 0) {
+		return 5;
+	} else if (strcasecmp(key, "freeze") == 0) {
+		return 6;
+	} else if (strcasecmp(key, "ltim") == 0) {
+		return 7;
+	} else if (strcasecmp(key, "modelname") == 0) {
+		return 8;
+	}
+	return -1;
+}
+
+struct Handler {
+	const char *key;
+	int branch;
+};
+
+static constexpr Handler handlers[] = {
+	{ "pow", 0 }, { "sour", 1 }, { "mute", 2 }, { "vol", 3 }, { "lampm", 4 }, { "blank", 5 },
+	{ "freeze", 6 }, { "ltim", 7 }, { "modelname", 8 },
+};
+static constexpr KeyTable<Handler, sizeof(handlers) / sizeof(handlers[0])> table(handlers);
+
+static int tableDispatch(const char *key) {
+	const Handler *handler = table.find(key);
+	return handler != NULL ? handler->branch : -1;
+}
+
+int main() {
+	const int keyCount = sizeof(replyKeys) / sizeof(replyKeys[0]);
+	printf("dispatch %d reply keys (9 known, %d unknown)\n", keyCount, keyCount - 9);
+
+	int mismatches = 0;
+	for (auto key : replyKeys) {
+		if (legacyDispatch(key) != tableDispatch(key)) {
+			printf("  MISMATCH for %s\n", key);
+			mismatches++;
+		}
+	}
+
+	double legacyNanos = bench("strcasecmp chain", 2000000, []() {
+		int sum = 0;
+		for (auto key : replyKeys) {
+			doNotOptimize(key);
+			sum += legacyDispatch(key);
+		}
+		doNotOptimize(sum);
+	});
+
+	double tableNanos = bench("KeyTable perfect hash", 2000000, []() {
+		int sum = 0;
+		for (auto key : replyKeys) {
+			doNotOptimize(key);
+			sum += tableDispatch(key);
+		}
+		doNotOptimize(sum);
+	});
+
+	printf("  %-48s %9.2fx\n", "speedup", legacyNanos / tableNanos);
+
+	return mismatches == 0 ? 0 : 1;
+}
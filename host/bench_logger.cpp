@@ -0,0 +1,176 @@
+/** Logger microbenchmark.
+ * Compares the old logger (a stringstream per message, copied into a std::deque of std::string
+ * and again by value for each listener) with the arena Logger on the bridge's typical comm and
+ * debug lines, checks that logging into the arena never allocates, and checks the ring and the
+ * deferred formatting against snprintf.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <list>
+#include <sstream>
+#include <string>
+
+#include "bench.hpp"
+#include "logger.hpp"
+
+// the old Logger, as it was
+struct LegacyLogger {
+	struct Entry {
+		LogEntryType type;
+		std::string entry;
+	};
+
+	std::list<std::function<void(Entry)>> listeners;
+	std::deque<Entry> entries;
+
+	void log(LogEntryType type, std::string entry) {
+		Entry logEntry{type, entry};
+		entries.push_back(logEntry);
+		while (entries.size() > 32) {
+			entries.pop_front();
+		}
+		for (auto it = listeners.begin(); it != listeners.end(); it++) {
+			(*it)(logEntry);
+		}
+	}
+};
+
+int main() {
+	int failures = 0;
+
+	const char command[] = "vol=?";
+	const char line[] = "*VOL=5#";
+	unsigned long timeout = 50, gap = 4;
+
+	// one poll's worth of comm logging plus the odd debug line, with a listener attached (the
+	// Serial console when SERIAL_LOGGING is on)
+	printf("log a sent/echo/received triple and a debug line\n");
+
+	LegacyLogger legacy;
+	long legacyHeard = 0;
+	legacy.listeners.push_back([&legacyHeard](LegacyLogger::Entry entry) { legacyHeard += entry.entry.size(); });
+
+	double legacyNanos = bench("stringstream, deque<string>", 200000, [&]() {
+		legacy.log(COMM_SENT, command);
+		legacy.log(COMM_ECHO, std::string(line + 1, 5));
+		legacy.log(COMM_RECV, line);
+		std::stringstream log;
+		log << "No echo from projector for " << command << " within " << timeout << "ms; send gap is now " << gap << "ms";
+		legacy.log(DEBUG_LOG, log.str());
+	});
+
+	Logger logger;
+	long heard = 0;
+	logger.addListener([&heard](const LogEntry &entry) { heard += entry.argsLen; });
+
+	auto logPoll = [&]() {
+		logger.commSent("%s", command);
+		logger.commEcho("%.*s", 5, line + 1);
+		logger.commRecv("%s", line);
+		logger.debug("No echo from projector for %s within %lums; send gap is now %lums", command, timeout, gap);
+	};
+	double arenaNanos = bench("arena Logger, deferred formatting", 200000, logPoll);
+
+	printf("  %-48s %9.2fx\n", "speedup", legacyNanos / arenaNanos);
+	doNotOptimize(legacyHeard);
+	doNotOptimize(heard);
+
+	long allocations = host::getAllocationCount();
+	for (int i = 0; i < 10000; ++i) {
+		logPoll();
+	}
+	allocations = host::getAllocationCount() - allocations;
+	printf("  %-48s %9ld\n", "heap allocations logging 40000 entries", allocations);
+	if (allocations != 0) {
+		failures++;
+	}
+
+	// formatting a whole /log page's worth is the part that's been deferred
+	bench("format every entry in the arena", 20000, [&]() {
+		char formatted[LOG_LINE_SIZE];
+		size_t total = 0;
+		logger.foreach([&](const LogEntry &entry) { total += entry.format(formatted, sizeof(formatted)); });
+		doNotOptimize(total);
+	});
+
+	// the arena has to hand back exactly the newest entries, in order, however they wrapped
+	{
+		Logger ring;
+		std::deque<std::string> expected;
+		char padding[LOG_MAX_STRING + 1];
+		memset(padding, 'x', sizeof(padding) - 1);
+		padding[sizeof(padding) - 1] = 0;
+
+		uint32_t seed = 0x9E3779B9;
+		for (int i = 0; i < 5000; ++i) {
+			seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+			int len = seed % (LOG_MAX_STRING + 1);
+
+			ring.info("%d: %.*s", i, len, padding);
+
+			char reference[LOG_LINE_SIZE];
+			snprintf(reference, sizeof(reference), "%d: %.*s", i, len, padding);
+			expected.push_back(reference);
+
+			std::deque<std::string> actual;
+			ring.foreach([&actual](const LogEntry &entry) {
+				char formatted[LOG_LINE_SIZE];
+				entry.format(formatted, sizeof(formatted));
+				actual.push_back(formatted);
+			});
+
+			while (expected.size() > actual.size()) {
+				expected.pop_front();
+			}
+			if (actual != expected || actual.empty() || actual.back() != reference) {
+				printf("  RING MISMATCH after entry %d\n", i);
+				failures++;
+				break;
+			}
+		}
+	}
+
+	// formatting has to match snprintf for everything the bridge logs with
+	{
+		Logger formats;
+		char expected[LOG_LINE_SIZE], formatted[LOG_LINE_SIZE];
+		int checked = 0;
+
+		auto check = [&](const char *reference) {
+			formats.foreach([&](const LogEntry &entry) { entry.format(formatted, sizeof(formatted)); });
+			checked++;
+			if (strcmp(reference, formatted) != 0) {
+				printf("  FORMAT MISMATCH: expected \"%s\", got \"%s\"\n", reference, formatted);
+				failures++;
+			}
+		};
+
+		formats.error("Volume %d is out of range (0-%d)", -3, 20);
+		snprintf(expected, sizeof(expected), "Volume %d is out of range (0-%d)", -3, 20);
+		check(expected);
+
+		formats.debug("gap %lums, timeout %5lu, %-4s|, %x %c %%", 4UL, 50UL, "ab", 255, 'z');
+		snprintf(expected, sizeof(expected), "gap %lums, timeout %5lu, %-4s|, %x %c %%", 4UL, 50UL, "ab", 255, 'z');
+		check(expected);
+
+		formats.info("%.1f average, %ld max, %s", 1.25, 7L, (const char *)NULL);
+		snprintf(expected, sizeof(expected), "%.1f average, %ld max, %s", 1.25, 7L, "");
+		check(expected);
+
+		formats.info("%d and %s", 1);
+		check("1 and ?");
+
+		// cut off, but still terminated
+		std::string longest(LOG_MAX_STRING, 'y');
+		formats.info("%s%s", longest.c_str(), longest.c_str());
+		check(std::string(LOG_LINE_SIZE - 1, 'y').c_str());
+
+		printf("  %-48s %9d\n", "formats checked against snprintf", checked);
+	}
+
+	printf("  %-48s %9d\n", "failures", failures);
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,90 @@
+/** Send queue microbenchmark.
+ * Compares the old heap-allocated std::queue<const char *> send queue with the inline
+ * CommandQueue ring, on the poll workload (8 queries queued, then sent one at a time), and checks
+ * that queueing through BenQProjector doesn't allocate.
+ */
+
+#include <Arduino.h>
+
+#include <cstdio>
+#include <cstring>
+#include <queue>
+
+#include "bench.hpp"
+#include "command_queue.hpp"
+#include "logger.hpp"
+#include "projector.hpp"
+#include "sim_projector.hpp"
+
+static const char *pollKeys[] = { "pow", "sour", "vol", "mute", "lampm", "blank", "freeze", "ltim" };
+
+// the way BenQProjector used to queue commands
+struct LegacyQueue {
+	std::queue<const char *> sendQueue;
+
+	void queueValue(const char *key, const char *value) {
+		char *toQueue = new char[strlen(key) + strlen(value) + 2];
+		strcpy(toQueue, key);
+		strcat(toQueue, "=");
+		strcat(toQueue, value);
+		sendQueue.push(toQueue);
+	}
+
+	size_t sendNext() {
+		const char *toSend = sendQueue.front();
+		sendQueue.pop();
+		size_t sent = strlen(toSend);
+		delete[] toSend;
+		return sent;
+	}
+};
+
+int main() {
+	printf("poll cycle (queue 8 queries, send 8)\n");
+
+	LegacyQueue legacy;
+	double legacyNanos = bench("std::queue<const char *> + new char[]", 1000000, [&legacy]() {
+		size_t sent = 0;
+		for (auto key : pollKeys) {
+			legacy.queueValue(key, "?");
+		}
+		for (int i = 0; i < 8; ++i) {
+			sent += legacy.sendNext();
+		}
+		doNotOptimize(sent);
+	});
+
+	CommandQueue queue;
+	double ringNanos = bench("CommandQueue ring", 1000000, [&queue]() {
+		size_t sent = 0;
+		for (auto key : pollKeys) {
+			queue.push(PRIORITY_POLL, key, "?");
+		}
+		for (int i = 0; i < 8; ++i) {
+			sent += strlen(queue.front());
+			queue.pop();
+		}
+		doNotOptimize(sent);
+	});
+
+	printf("  %-48s %9.2fx\n", "speedup", legacyNanos / ringNanos);
+
+	// queueing through the projector itself must not allocate once it's constructed
+	Logger logger;
+	SimulatedProjector sim;
+	Scheduler scheduler;
+	StateStore store(logger, scheduler, 0, STATE_STORE_SECTORS);
+	BenQProjector projector(logger, scheduler, store, sim, sim, 3);
+
+	long allocations = host::getAllocationCount();
+	for (int i = 0; i < PROJECTOR_INTERACTIVE_QUEUE_DEPTH / 2; ++i) {
+		projector.queueQuery(pollKeys[i % 8]);
+		projector.queueRaw("menu");
+	}
+	allocations = host::getAllocationCount() - allocations;
+
+	printf("BenQProjector::queueQuery + queueRaw x%d\n", PROJECTOR_INTERACTIVE_QUEUE_DEPTH / 2);
+	printf("  %-48s %9ld\n", "heap allocations", allocations);
+
+	return allocations == 0 ? 0 : 1;
+}
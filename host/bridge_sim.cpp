@@ -0,0 +1,989 @@
+/** Host simulation of the BenQ projector/MQTT bridge.
+ * Runs the bridge core against a simulated projector on a virtual clock, drives it through a
+ * power/source/volume scenario over MQTT and HTTP, and reports loop cost and command latency.
+ *
+ * Usage: bridge_sim [-v] [--step-us N]
+ *   -v           echo the bridge log to stdout
+ *   --step-us N  virtual time that passes per main loop iteration (default 100)
+ */
+
+#include "config.h"
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "histogram.hpp"
+#include "logger.hpp"
+#include "loop_profiler.hpp"
+#include "projector.hpp"
+#include "power_state.hpp"
+#include "state_store.hpp"
+#include "status_cache.hpp"
+#include "transition_model.hpp"
+#include "utils.hpp"
+#include "mqtt.hpp"
+#include "http.hpp"
+#include "sim_projector.hpp"
+
+using std::string;
+
+static unsigned long stepMicros = 100;
+static bool verbose = false;
+
+static Logger logger;
+static SimulatedProjector sim;
+
+static Scheduler scheduler;
+
+static StateStore stateStore(logger, scheduler, 0, STATE_STORE_SECTORS);
+
+static BenQProjector projector(logger, scheduler, stateStore, sim, sim, 3);
+
+static PowerState projectorPower(
+	logger, scheduler, projector,
+	10 * 60, 6 * 60 * 60, 5 * 60,
+	2 * 60, 2 * 60 * 60
+);
+
+static StatusCache status(projector, projectorPower);
+
+static LoopProfiler profiler;
+static int projectorSection = profiler.addSection("projector");
+static int httpSection = profiler.addSection("http");
+static int mqttSection = profiler.addSection("mqtt");
+static int timersSection = profiler.addSection("timers");
+
+static MqttSupport mqtt(
+	logger, projector, projectorPower, status,
+	profiler, scheduler,
+	MQTT_STATUS_INTERVAL,
+	CLIENT_NAME,
+	MQTT_SERVER, MQTT_SERVER_PORT,
+	MQTT_USERNAME, MQTT_PASSWORD,
+	MQTT_SET_POWER_TOPIC, MQTT_SET_VOLUME_TOPIC, MQTT_SET_SOURCE_TOPIC, MQTT_SET_LAMP_MODE_TOPIC,
+	MQTT_REMOTE_COMMAND_TOPIC,
+	MQTT_RAW_COMMAND_TOPIC,
+	MQTT_STATUS_TOPIC,
+	MQTT_STATS_TOPIC
+);
+
+static HttpSupport http(logger, projector, projectorPower, status, profiler, HTTP_PORT, false);
+
+static EspMQTTClient &mqttClient = *EspMQTTClient::latest();
+static ESP8266WebServer &httpServer = *ESP8266WebServer::latest();
+
+// loop cost, in host CPU time
+static struct {
+	long iterations = 0;
+	double totalNanos = 0, projectorNanos = 0;
+	double maxNanos = 0;
+} loopStats;
+
+// the same, for /metrics the way the sketch keeps it (but in host CPU time, since virtual time
+// doesn't move within a loop)
+static const unsigned long loopTimeBounds[] = { 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000 };
+static Histogram<10> loopTime(loopTimeBounds);
+
+// virtual time the next HTTP loop takes, to simulate a slow handler
+static unsigned long httpStallMicros = 0;
+
+static int failures = 0;
+
+static void loopOnce() {
+	auto start = std::chrono::steady_clock::now();
+	profiler.begin();
+	projector.loop();
+	profiler.mark(projectorSection);
+	auto afterProjector = std::chrono::steady_clock::now();
+	http.loop();
+	host::advanceMicros(httpStallMicros);
+	httpStallMicros = 0;
+	profiler.mark(httpSection);
+	mqtt.loop();
+	profiler.mark(mqttSection);
+	scheduler.loop();
+	profiler.mark(timersSection);
+	profiler.end();
+	auto end = std::chrono::steady_clock::now();
+
+	double total = std::chrono::duration<double, std::nano>(end - start).count();
+	loopStats.iterations++;
+	loopStats.totalNanos += total;
+	loopStats.projectorNanos += std::chrono::duration<double, std::nano>(afterProjector - start).count();
+	loopTime.observe(total / 1000);
+	if (total > loopStats.maxNanos) {
+		loopStats.maxNanos = total;
+	}
+
+	host::advanceMicros(stepMicros);
+}
+
+static void runFor(unsigned long ms) {
+	uint64_t until = host::getMicros() + (uint64_t)ms * 1000;
+	while (host::getMicros() < until) {
+		loopOnce();
+	}
+}
+
+// runs until the condition holds, returning how long that took in virtual ms (or -1 on timeout)
+static long runUntil(std::function<bool()> condition, unsigned long timeoutMs) {
+	uint64_t start = host::getMicros();
+	uint64_t until = start + (uint64_t)timeoutMs * 1000;
+
+	while (!condition()) {
+		if (host::getMicros() >= until) {
+			return -1;
+		}
+		loopOnce();
+	}
+
+	return (host::getMicros() - start) / 1000;
+}
+
+static void report(const char *what, long ms) {
+	if (ms < 0) {
+		printf("  %-44s TIMED OUT\n", what);
+		failures++;
+	} else {
+		printf("  %-44s %6ld ms\n", what, ms);
+	}
+}
+
+// MQTT publications to the status topic, from the index given on
+static std::vector<EspMQTTClient::Publication> statusPublications(size_t from = 0) {
+	std::vector<EspMQTTClient::Publication> found;
+	auto &publications = mqttClient.getPublications();
+	for (size_t i = from; i < publications.size(); ++i) {
+		if (publications[i].topic == MQTT_STATUS_TOPIC) {
+			found.push_back(publications[i]);
+		}
+	}
+	return found;
+}
+
+// the value of a metric's sample in /metrics text, or -1 if it isn't there
+static double metricValue(const string &text, const string &sample) {
+	size_t at = 0;
+	while ((at = text.find(sample + " ", at)) != string::npos) {
+		if (at == 0 || text[at - 1] == '\n') {
+			return atof(text.c_str() + at + sample.size() + 1);
+		}
+		at++;
+	}
+	return -1;
+}
+
+static void check(const char *what, bool ok) {
+	if (!ok) {
+		printf("  CHECK FAILED: %s\n", what);
+		failures++;
+	}
+}
+
+// every command the simulated projector accepted, in order
+static std::vector<std::pair<unsigned long, string>> wire;
+
+static bool sentSince(size_t since, const char *command) {
+	for (size_t i = since; i < wire.size(); ++i) {
+		if (strcasecmp(wire[i].second.c_str(), command) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// result of the last interactive command the bridge got an answer for
+static int lastResult = -1;
+
+// the loop pass blanking last changed on, and the one PowerState's state last changed on
+static long blankChangedOn = -1, powerStateChangedOn = -1;
+
+// time from now until the simulated projector accepts a command starting with the given text
+static string awaitedCommand;
+static long awaitedAt = -1;
+
+static void expectCommand(const char *command) {
+	awaitedCommand = command;
+	awaitedAt = -1;
+}
+
+static long commandLatency(unsigned long sentAt, unsigned long timeoutMs) {
+	long took = runUntil([]() { return awaitedAt >= 0; }, timeoutMs);
+	return took < 0 ? -1 : awaitedAt - (long)sentAt;
+}
+
+int main(int argc, char **argv) {
+	for (int i = 1; i < argc; ++i) {
+		string arg = argv[i];
+		if (arg == "-v") {
+			verbose = true;
+		} else if (arg == "--step-us" && i + 1 < argc) {
+			stepMicros = strtoul(argv[++i], nullptr, 10);
+		} else {
+			fprintf(stderr, "usage: %s [-v] [--step-us N]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	// flash kept next to the binary, starting out erased, so the scenario runs the same every time
+	string flashPath = argv[0];
+	flashPath = flashPath.substr(0, flashPath.find_last_of('/') + 1) + "sim_flash.bin";
+	remove(flashPath.c_str());
+	if (!host::setFlashFile(flashPath.c_str())) {
+		fprintf(stderr, "can't open %s\n", flashPath.c_str());
+		return 1;
+	}
+
+	if (verbose) {
+		logger.addListener([](const LogEntry &entry) {
+			const char *prefix = "";
+			switch (entry.type) {
+				case DEBUG_LOG: prefix = "DEBUG "; break;
+				case INFO_LOG:  prefix = "INFO  "; break;
+				case ERROR_LOG: prefix = "ERROR "; break;
+				case COMM_SENT: prefix = "  >>  "; break;
+				case COMM_ECHO: prefix = "  <>  "; break;
+				case COMM_RECV: prefix = "  <<  "; break;
+			}
+			char line[LOG_LINE_SIZE];
+			entry.format(line, sizeof(line));
+			printf("%10.3f %s%s\n", millis() / 1000.0, prefix, line);
+		});
+	}
+
+	sim.onCommand([](const char *command, unsigned long at) {
+		wire.push_back({ at, command });
+
+		if (awaitedAt < 0 && !awaitedCommand.empty() && strncasecmp(command, awaitedCommand.c_str(), awaitedCommand.size()) == 0) {
+			awaitedAt = at;
+		}
+	});
+
+	projector.addCommandListener([](const char *command, CommandPriority priority, CommandResult result) {
+		if (priority == PRIORITY_INTERACTIVE) {
+			lastResult = result;
+		}
+	});
+
+	projector.begin();
+	projectorPower.begin();
+
+	// (after PowerState's own listener, so it's had its say by the time these run)
+	projector.addChangeListener([](const ProjectorChange &change) {
+		if (change.field == FIELD_BLANK) {
+			blankChangedOn = loopStats.iterations;
+		}
+	});
+	projectorPower.addChangeListener([]() {
+		powerStateChangedOn = loopStats.iterations;
+	});
+	http.setup();
+	mqtt.setup();
+	http.addMetrics([](MetricsWriter &metrics) {
+		metrics.histogram("benq_loop_duration_microseconds", "Time taken by each pass through the main loop.", loopTime);
+		metrics.counter("benq_mqtt_connections_total", "Times the MQTT broker was connected to, including the first.", mqtt.getConnectionCount());
+	});
+
+	printf("startup\n");
+	report("projector state initialized", runUntil([]() { return projector.isInitialized(); }, 5000));
+
+	// the bridge won't turn the projector on within the minimum off time of boot, so idle until
+	// then; this doubles as a measurement of steady-state polling traffic while off
+	runFor(5 * 60 * 1000 + 1000);
+	long idleCommands = sim.getCommandCount();
+
+	printf("MQTT reconnects while idle\n");
+	for (int i = 0; i < 3; ++i) {
+		mqttClient.dropConnection();
+		runFor(1000);
+	}
+	mqttClient.clearPublications();
+	runFor(2 * MQTT_STATUS_INTERVAL + 1000);
+	printf("  %-44s %6zu\n", "status publishes in 2 heartbeat intervals", statusPublications().size());
+	check("reconnects don't start extra publishers", statusPublications().size() == 2 && mqttClient.getPendingDelayedCount() == 0);
+
+	printf("power on (MQTT)\n");
+	unsigned long sentAt = millis();
+	expectCommand("pow=on");
+	size_t publishedBefore = mqttClient.getPublications().size();
+	mqttClient.inject(MQTT_SET_POWER_TOPIC, "on");
+	report("request to pow=on on the wire", commandLatency(sentAt, 5000));
+	report("power on published to MQTT", runUntil([publishedBefore]() {
+		auto &publications = mqttClient.getPublications();
+		for (size_t i = publishedBefore; i < publications.size(); ++i) {
+			if (publications[i].payload.find("\"power\":true") != string::npos) {
+				return true;
+			}
+		}
+		return false;
+	}, 5000));
+	report("bridge reports projector on", runUntil([]() { return projector.isOn(); }, 60000));
+	report("projector warm-up complete", runUntil([]() { return sim.isOn(); }, 60000));
+	report("model name known", runUntil([]() { return projector.getModelName()[0] != 0; }, 30000));
+
+	printf("source, changed twice in a row (MQTT)\n");
+	sentAt = millis();
+	size_t wireBefore = wire.size();
+	expectCommand("sour=hdmi2");
+	mqttClient.inject(MQTT_SET_SOURCE_TOPIC, "rgb");
+	mqttClient.inject(MQTT_SET_SOURCE_TOPIC, "hdmi2");
+	report("request to sour=hdmi2 on the wire", commandLatency(sentAt, 10000));
+	report("bridge reports new source", runUntil([]() { return strcasecmp(projector.getSource(), "hdmi2") == 0; }, 10000));
+	check("superseded sour=rgb was never sent", !sentSince(wireBefore, "sour=rgb"));
+
+	printf("burst of 8 raw queries (HTTP)\n");
+	sentAt = millis();
+	wireBefore = wire.size();
+	for (auto key : { "pow", "sour", "vol", "mute", "lampm", "blank", "freeze", "ltim" }) {
+		httpServer.request(HTTP_POST, "/send", { { "cmd", string(key) + "=?" } });
+	}
+	report("all 8 on the wire", runUntil([wireBefore]() { return sentSince(wireBefore, "ltim=?"); }, 10000));
+
+	printf("noisy line, every 4th command lost for 30s\n");
+	long retriesBefore, givenUpBefore, retries, givenUp;
+	projector.getCommandStats(retriesBefore, givenUpBefore);
+	sim.setLoseEvery(4);
+	runFor(15000);
+	sim.sendNoise("~\x7f#=*");
+	runFor(15000);
+	sim.setLoseEvery(0);
+	projector.getCommandStats(retries, givenUp);
+	printf("  %-44s %6ld\n", "retries", retries - retriesBefore);
+	printf("  %-44s %6ld\n", "commands given up on", givenUp - givenUpBefore);
+	check("lost commands were retried", retries > retriesBefore);
+	check("no command was given up on", givenUp == givenUpBefore);
+
+	printf("volume 5 -> 12 (MQTT)\n");
+	sentAt = millis();
+	expectCommand("vol=+");
+	mqttClient.inject(MQTT_SET_VOLUME_TOPIC, "12");
+	report("first volume step on the wire", commandLatency(sentAt, 10000));
+	report("projector reaches volume 12", runUntil([]() { return sim.getVolume() == 12; }, 120000));
+	runFor(10000);
+	check("projector volume settles at 12", sim.getVolume() == 12);
+
+	printf("volume 12 -> 20 (MQTT)\n");
+	mqttClient.inject(MQTT_SET_VOLUME_TOPIC, "20");
+	long upTook = runUntil([]() { return sim.getVolume() == 20; }, 10000);
+	report("projector reaches volume 20", upTook);
+	check("volume 12 -> 20 takes well under a second", upTook >= 0 && upTook < 500);
+	runFor(1000);
+
+	printf("volume 20 -> 3, changed to 15 on the way (MQTT)\n");
+	mqttClient.inject(MQTT_SET_VOLUME_TOPIC, "3");
+	runFor(50);
+	int lowest = sim.getVolume();
+	mqttClient.inject(MQTT_SET_VOLUME_TOPIC, "15");
+	report("projector reaches volume 15", runUntil([&lowest]() {
+		lowest = std::min(lowest, sim.getVolume());
+		return sim.getVolume() == 15 && projector.getQueueDepth(PRIORITY_INTERACTIVE) == 0;
+	}, 10000));
+	printf("  %-44s %6d\n", "lowest volume on the way", lowest);
+	// in 50ms, a few steps have gone out; no more than the steps-ahead cap may follow them
+	check("overshoot is capped", lowest >= 20 - 3 - PROJECTOR_VOLUME_STEPS_AHEAD);
+	runFor(10000);
+	check("projector volume settles at 15", sim.getVolume() == 15);
+
+	printf("volume 35, out of range (MQTT)\n");
+	mqttClient.inject(MQTT_SET_VOLUME_TOPIC, "35");
+	report("projector reaches volume 20", runUntil([]() { return sim.getVolume() == 20; }, 10000));
+	runFor(1000);
+	wireBefore = wire.size();
+	runFor(10000);
+	check("no more volume steps once at the top", !sentSince(wireBefore, "vol=+"));
+
+	printf("pages (HTTP)\n");
+	for (const char *page : { "/", "/log", "/stats" }) {
+		auto response = httpServer.request(HTTP_GET, page);
+		printf("  %-44s %6zu bytes in %d chunks, %zu bytes of heap\n", page, response.body.size(), response.chunks, response.peakHeap);
+		check("page is streamed in chunks", response.code == 200 && response.chunked && response.chunks > 1);
+		check("page is complete", response.body.size() > 6 && response.body.compare(response.body.size() - 7, 7, "</html>") == 0);
+		// the page only ever passes through the chunk buffer, so it needs less heap than its size
+		check("page needs less heap than it is long", response.peakHeap < response.body.size());
+	}
+
+	printf("conditional GET (HTTP)\n");
+	{
+		auto fresh = httpServer.request(HTTP_GET, "/status");
+		string etag = fresh.header("ETag");
+		long serializations = status.getSerializations();
+		auto cached = httpServer.request(HTTP_GET, "/status", {}, { { "If-None-Match", etag } });
+		printf("  %-44s %s -> %d\n", "/status with its own ETag", etag.c_str(), cached.code);
+		check("/status has an ETag", fresh.code == 200 && !etag.empty());
+		check("unchanged /status answered 304 with no body", cached.code == 304 && cached.body.empty());
+		check("304 didn't need the status serialized", status.getSerializations() == serializations);
+
+		for (const char *page : { "/", "/log", "/stats" }) {
+			string pageTag = httpServer.request(HTTP_GET, page).header("ETag");
+			check("unchanged page answered 304", httpServer.request(HTTP_GET, page, {}, { { "If-None-Match", pageTag } }).code == 304);
+		}
+
+		string rootTag = httpServer.request(HTTP_GET, "/").header("ETag");
+		runFor(HTTP_ETAG_PERIOD);
+		check("/ is sent again once its times are out of date", httpServer.request(HTTP_GET, "/", {}, { { "If-None-Match", rootTag } }).code == 200);
+
+		mqttClient.inject(MQTT_SET_VOLUME_TOPIC, "19");
+		runUntil([]() { return sim.getVolume() == 19 && projector.getQueueDepth(PRIORITY_INTERACTIVE) == 0; }, 5000);
+		runFor(MQTT_STATUS_DEBOUNCE + 100);
+		auto changed = httpServer.request(HTTP_GET, "/status", {}, { { "If-None-Match", etag } });
+		printf("  %-44s %s -> %d\n", "/status after a volume change", changed.header("ETag").c_str(), changed.code);
+		check("changed /status sent again with a new ETag", changed.code == 200 && changed.header("ETag") != etag);
+	}
+
+	printf("events (HTTP)\n");
+	{
+		WiFiClient reader = httpServer.request(HTTP_GET, "/events").client;
+		WiFiClient laggard = httpServer.request(HTTP_GET, "/events").client;
+		check("third /events client turned away", httpServer.request(HTTP_GET, "/events").code == 503);
+
+		string stream = reader.take();
+		check("subscriber gets the event stream headers", stream.find("Content-Type: text/event-stream\r\n") != string::npos);
+		check("subscriber gets the whole status first", stream.find("event: status\ndata: {\"power\":true,") != string::npos);
+
+		mqttClient.inject(MQTT_SET_VOLUME_TOPIC, "17");
+		report("volume change pushed as a status delta", runUntil([&]() {
+			stream += reader.take();
+			return stream.find("event: status\ndata: {\"volume\":17}\n\n") != string::npos;
+		}, 5000));
+		check("commands sent pushed as log events", stream.find("event: log\ndata:   >>  vol=-\n\n") != string::npos);
+
+		// the laggard never reads anything, so sooner or later an event won't fit
+		report("client that never reads is dropped", runUntil([&]() {
+			stream += reader.take();
+			return !laggard.connected();
+		}, 5 * 60 * 1000));
+		check("client that keeps up stays subscribed", reader.connected());
+		check("no write to a subscriber ever blocked", reader.getStalls() == 0 && laggard.getStalls() == 0);
+
+		// a raw command is logged as it was sent, line breaks and all
+		mqttClient.inject(MQTT_RAW_COMMAND_TOPIC, "x\n\nevent: status\ndata: {\"injected\":true}");
+		report("raw command with line breaks logged", runUntil([&]() {
+			stream += reader.take();
+			return stream.find("{\"injected\":true}") != string::npos;
+		}, 5000));
+		check("log lines can't break out into events of their own", stream.find("\nevent: status\ndata: {\"injected\"") == string::npos);
+
+		reader.stop();
+		runFor(EVENT_STREAM_KEEPALIVE);
+		check("/stats shows nobody listening once the reader hangs up",
+			httpServer.request(HTTP_GET, "/stats").body.find("Listening to /events: 0 (1 dropped") != string::npos);
+	}
+
+	printf("slow HTTP handler\n");
+	httpStallMicros = 30000;
+	runFor(1000);
+	LoopProfiler::Timing loopTiming, httpTiming, projectorTiming;
+	profiler.getTiming(0, loopTiming);
+	profiler.getTiming(projectorSection, projectorTiming);
+	profiler.getTiming(httpSection, httpTiming);
+	printf("  %-44s %6lu us\n", "loop p99", loopTiming.p99);
+	printf("  %-44s %6lu us\n", "loop max", loopTiming.max);
+	check("stall attributed to HTTP", httpTiming.max == 30000 && httpTiming.overBudget == 1 && loopTiming.overBudget == 1 &&
+		projectorTiming.max < LOOP_PROFILER_BUDGET && projectorTiming.overBudget == 0);
+	check("one stall doesn't move p99", loopTiming.p99 < LOOP_PROFILER_BUDGET);
+	auto stats = httpServer.request(HTTP_GET, "/stats");
+	check("loop time on /stats", stats.body.find("<tr><td>http</td>") != string::npos && stats.body.find("<td>30000</td><td>1</td></tr>") != string::npos);
+	size_t statsPublishedBefore = mqttClient.getPublications().size();
+	// (by then the stall has aged out of the window, but not the over budget count)
+	report("loop time published to MQTT", runUntil([statsPublishedBefore]() {
+		auto &publications = mqttClient.getPublications();
+		for (size_t i = statsPublishedBefore; i < publications.size(); ++i) {
+			if (publications[i].topic == MQTT_STATS_TOPIC "/http" && publications[i].payload.find("\"over_budget\":1}") != string::npos) {
+				return true;
+			}
+		}
+		return false;
+	}, MQTT_STATUS_INTERVAL + 1000));
+
+	printf("idle while on\n");
+	long onCommandsBefore = sim.getCommandCount();
+	long onFiredBefore = scheduler.getFiredCount();
+	runFor(5 * 60 * 1000);
+	float onCommandsPerMinute = (sim.getCommandCount() - onCommandsBefore) / 5.0f;
+	float onFiredPerMinute = (scheduler.getFiredCount() - onFiredBefore) / 5.0f;
+	// polling all 8 keys every poll interval would be 160 a minute
+	printf("  %-44s %9.1f\n", "commands per minute", onCommandsPerMinute);
+	check("polling backs off once values are known", onCommandsPerMinute < 160 / 5);
+	// checking the status for changes every debounce time would be 300 a minute on its own
+	printf("  %-44s %9.1f\n", "timer callbacks per minute", onFiredPerMinute);
+	check("status only looked at when it changes", onFiredPerMinute < 60000 / MQTT_STATUS_DEBOUNCE / 2);
+	long powAge = -1;
+	const char *key;
+	long ageMs;
+	for (size_t i = 0; projector.getValueAge(i, key, ageMs); ++i) {
+		if (strcmp(key, "pow") == 0) {
+			powAge = ageMs;
+		}
+	}
+	check("power is still polled every interval", powAge >= 0 && powAge <= 3 * 1000 * 11 / 10);
+
+	printf("blank turned off by hand while virtually off (MQTT)\n");
+	mqttClient.inject(MQTT_SET_POWER_TOPIC, "off");
+	report("projector blanked", runUntil([]() { return projector.isImageBlanked(); }, 5000));
+	check("power off is pending", !projectorPower.getVirtualPowerState() && projectorPower.getTimeUntilRealOff() > 0);
+	mqttClient.inject(MQTT_RAW_COMMAND_TOPIC, "blank=off");
+	report("virtual power back on", runUntil([]() { return projectorPower.getVirtualPowerState(); }, 5000));
+	check("pending off cancelled on the pass blank=off came in", blankChangedOn >= 0 && powerStateChangedOn == blankChangedOn);
+
+	printf("power off (HTTP)\n");
+	sentAt = millis();
+	expectCommand("blank=on");
+	httpServer.request(HTTP_POST, "/cmd/power-off");
+	report("request to blank=on on the wire", commandLatency(sentAt, 10000));
+	check("virtual power is off", !projectorPower.getVirtualPowerState());
+	runFor(MQTT_STATUS_DEBOUNCE + 100);
+	auto virtualOffStatus = httpServer.request(HTTP_GET, "/status");
+	printf("  %-44s %s\n", "/status while virtually off", virtualOffStatus.body.c_str());
+	check("/status reports virtual power, like MQTT", virtualOffStatus.body.find("\"power\":false") != string::npos &&
+		virtualOffStatus.body == statusPublications().back().payload);
+	report("projector starts cooling down", runUntil([]() { return sim.getPowerPhase() == SimulatedProjector::COOLING_DOWN; }, 15 * 60 * 1000));
+
+	printf("source while cooling down (MQTT)\n");
+	lastResult = -1;
+	mqttClient.inject(MQTT_SET_SOURCE_TOPIC, "hdmi");
+	report("sour=hdmi answered", runUntil([]() { return lastResult >= 0; }, 5000));
+	check("sour=hdmi reported as blocked", lastResult == COMMAND_BLOCKED);
+
+	report("bridge reports projector off", runUntil([]() { return strcmp(projector.getStatusStr(), "Off") == 0; }, 5 * 60 * 1000));
+
+	printf("metrics (HTTP)\n");
+	auto metrics = httpServer.request(HTTP_GET, "/metrics");
+	printf("  %-44s %6zu\n", "/metrics bytes", metrics.body.size());
+	if (verbose) fputs(metrics.body.c_str(), stdout);
+	check("/metrics is Prometheus text", metrics.code == 200 && metrics.contentType == "text/plain; version=0.0.4" && metrics.chunked);
+	check("latency buckets are cumulative, ending in the count", [&metrics]() {
+		double previous = 0;
+		for (size_t i = 0; i < projector.getResponseLatency().getBucketCount(); ++i) {
+			char sample[80];
+			snprintf(sample, sizeof(sample), "benq_response_latency_milliseconds_bucket{le=\"%lu\"}", projector.getResponseLatency().getBound(i));
+			double bucket = metricValue(metrics.body, sample);
+			if (bucket < previous) {
+				return false;
+			}
+			previous = bucket;
+		}
+		double all = metricValue(metrics.body, "benq_response_latency_milliseconds_bucket{le=\"+Inf\"}");
+		return all >= previous && all == metricValue(metrics.body, "benq_response_latency_milliseconds_count") && all > 0;
+	}());
+	printf("  %-44s %6.0f\n", "parse errors", metricValue(metrics.body, "benq_parse_errors_total"));
+	check("parse errors from the noisy line counted", metricValue(metrics.body, "benq_parse_errors_total") > 0);
+	check("blocked source change counted", metricValue(metrics.body, "benq_error_replies_total{reason=\"blocked\"}") >= 1);
+	check("age of the power state shown", metricValue(metrics.body, "benq_value_age_seconds{key=\"pow\"}") >= 0);
+	check("registered metrics included", metricValue(metrics.body, "benq_loop_duration_microseconds_count") > 0 &&
+		metricValue(metrics.body, "benq_mqtt_connections_total") == 4);
+
+	printf("second power cycle, with warm-up and cool-down learned (MQTT)\n");
+	{
+		long warmUpMs, coolDownMs;
+		int warmUpsSeen, coolDownsSeen;
+		projector.getLearnedTransitions(warmUpMs, warmUpsSeen, coolDownMs, coolDownsSeen);
+		printf("  %-44s %6ld ms\n", "warm-up learned from the first", warmUpMs);
+		printf("  %-44s %6ld ms\n", "cool-down learned from the first", coolDownMs);
+		check("first warm-up and cool-down learned", warmUpsSeen == 1 && coolDownsSeen == 1);
+		long writesBefore = stateStore.getWrites();
+
+		// (within the minimum off time, the request would be refused)
+		runUntil([]() { return millis() - projector.getLastOffTime() > 5 * 60 * 1000; }, 10 * 60 * 1000);
+		mqttClient.inject(MQTT_SET_POWER_TOPIC, "on");
+		report("bridge reports projector on", runUntil([]() { return projector.isOn(); }, 5000));
+		runFor(MQTT_STATUS_DEBOUNCE + 100);
+		auto warmingStatus = httpServer.request(HTTP_GET, "/status");
+		printf("  %-44s %s\n", "/status while warming up", warmingStatus.body.c_str());
+		check("/status has the warm-up ETA", warmingStatus.body.find("\"transition\":\"warming up\",\"eta\":") != string::npos);
+		check("MQTT has the warm-up ETA", statusPublications().back().payload.find("\"transition\":\"warming up\",\"eta\":") != string::npos);
+		check("/ shows the warm-up ETA", httpServer.request(HTTP_GET, "/").body.find("Still warming up, done in about") != string::npos);
+
+		// nothing but power goes out until about when the warm-up should be over
+		wireBefore = wire.size();
+		runFor(warmUpMs - warmUpMs * TRANSITION_MODEL_WINDOW_PERCENT / 100 - 1000);
+		check("warm-up probe waits for its window", !sentSince(wireBefore, "sour=?") && !sentSince(wireBefore, "vol=?"));
+
+		report("projector warm-up complete", runUntil([]() { return sim.isOn(); }, 60000));
+		long warmUpSeen = runUntil([]() { return projector.getTransition() == NULL; }, 60000);
+		report("bridge sees the end of the warm-up", warmUpSeen);
+		check("end of warm-up seen within a second", warmUpSeen >= 0 && warmUpSeen < 1000);
+		report("source known again", runUntil([]() { return strcmp(projector.getSource(), "none") != 0; }, 10000));
+
+		mqttClient.inject(MQTT_SET_POWER_TOPIC, "off");
+		report("projector starts cooling down", runUntil([]() { return sim.getPowerPhase() == SimulatedProjector::COOLING_DOWN; }, 15 * 60 * 1000));
+		runFor(MQTT_STATUS_DEBOUNCE + 100);
+		check("MQTT has the cool-down ETA", statusPublications().back().payload.find("\"transition\":\"cooling down\",\"eta\":") != string::npos);
+		report("projector cool-down complete", runUntil([]() { return sim.getPowerPhase() == SimulatedProjector::POWER_OFF; }, 5 * 60 * 1000));
+		long coolDownSeen = runUntil([]() { return projector.getTransition() == NULL; }, 60000);
+		report("bridge sees the end of the cool-down", coolDownSeen);
+		check("end of cool-down seen within a second", coolDownSeen >= 0 && coolDownSeen < 1000);
+		check("bridge reports projector off", strcmp(projector.getStatusStr(), "Off") == 0);
+
+		projector.getLearnedTransitions(warmUpMs, warmUpsSeen, coolDownMs, coolDownsSeen);
+		printf("  %-44s %6ld ms (%d seen)\n", "warm-up learned", warmUpMs, warmUpsSeen);
+		printf("  %-44s %6ld ms (%d seen)\n", "cool-down learned", coolDownMs, coolDownsSeen);
+		check("warm-up learned as about 30s", warmUpsSeen == 2 && warmUpMs >= 30000 && warmUpMs < 35000);
+		check("cool-down learned as about 90s", coolDownsSeen == 2 && coolDownMs >= 90000 && coolDownMs < 95000);
+		printf("  %-44s %6ld\n", "state writes during the cycle", stateStore.getWrites() - writesBefore);
+		// (one for each of on, cooling down and off, and the timings go out with the last two)
+		check("state writes coalesced", stateStore.getWrites() - writesBefore <= 4);
+		check("learned timings on /stats", httpServer.request(HTTP_GET, "/stats").body.find("Cool-down: ") != string::npos);
+	}
+
+	printf("reboot, with state restored from flash\n");
+	{
+		stateStore.flush();
+		printf("  %-44s %6ld\n", "state writes", stateStore.getWrites());
+		printf("  %-44s %6ld\n", "sectors erased", stateStore.getErases());
+
+		long warmUpMs, coolDownMs;
+		int warmUpsSeen, coolDownsSeen;
+		projector.getLearnedTransitions(warmUpMs, warmUpsSeen, coolDownMs, coolDownsSeen);
+
+		// a bridge of its own, on a scheduler of its own; the clock goes back afterwards, and nothing
+		// else runs in between
+		uint64_t savedMicros = host::getMicros();
+
+		// (the projector's still on, and this one doesn't have freeze)
+		SimulatedProjector::Config config;
+		config.startOn = true;
+		config.unsupportedKey = "freeze";
+		auto boot = [&](std::vector<string> &sent, std::function<void(BenQProjector &)> run) {
+			SimulatedProjector rebootedSim(config);
+			Scheduler rebootedScheduler;
+			StateStore rebootedStore(logger, rebootedScheduler, 0, STATE_STORE_SECTORS);
+			BenQProjector rebooted(logger, rebootedScheduler, rebootedStore, rebootedSim, rebootedSim, 3);
+			rebootedSim.onCommand([&sent](const char *command, unsigned long at) { sent.push_back(command); });
+
+			rebooted.begin();
+			run(rebooted);
+			for (int ms = 0; ms < 2 * PROJECTOR_POLL_STATUS_INTERVAL; ++ms) {
+				rebooted.loop();
+				rebootedScheduler.loop();
+				host::advanceMillis(1);
+			}
+			rebootedStore.flush();
+		};
+		auto wasSent = [](const std::vector<string> &sent, const char *key) {
+			return std::any_of(sent.begin(), sent.end(), [key](const string &command) { return command.compare(0, strlen(key), key) == 0; });
+		};
+
+		std::vector<string> sent;
+		boot(sent, [&](BenQProjector &rebooted) {
+			long rebootedWarmUpMs, rebootedCoolDownMs;
+			int rebootedWarmUpsSeen, rebootedCoolDownsSeen;
+			rebooted.getLearnedTransitions(rebootedWarmUpMs, rebootedWarmUpsSeen, rebootedCoolDownMs, rebootedCoolDownsSeen);
+			check("model name and lamp hours known before the first poll",
+				strcmp(rebooted.getModelName(), projector.getModelName()) == 0 && rebooted.getLampHours() == projector.getLampHours());
+			check("learned timings known before the first poll",
+				rebootedWarmUpMs == warmUpMs && rebootedWarmUpsSeen == warmUpsSeen && rebootedCoolDownMs == coolDownMs && rebootedCoolDownsSeen == coolDownsSeen);
+		});
+		check("model name and lamp hours not asked for again", !wasSent(sent, "modelname=?") && !wasSent(sent, "ltim=?"));
+		check("missing key asked about once", std::count(sent.begin(), sent.end(), "freeze=?") == 1);
+
+		sent.clear();
+		boot(sent, [](BenQProjector &) {});
+		check("missing key not asked about after another reboot", !wasSent(sent, "freeze=?") && wasSent(sent, "blank=?"));
+
+		host::setMicros(savedMicros);
+	}
+
+	printf("receive budget\n");
+	{
+		// a bridge of its own, where handling each frame takes 300us of the 1ms budget, and a burst of
+		// frames arrives all at once; the clock goes back afterwards
+		uint64_t savedMicros = host::getMicros();
+
+		Logger burstLogger;
+		SimulatedProjector burstSim;
+		Scheduler wheel;
+		StateStore store(burstLogger, wheel, 0, STATE_STORE_SECTORS);
+		BenQProjector bridge(burstLogger, wheel, store, burstSim, burstSim, 3);
+		bridge.setRecvBudget(1000);
+
+		std::vector<string> handled;
+		burstLogger.addListener([&handled](const LogEntry &entry) {
+			if (entry.type == COMM_RECV) {
+				char line[LOG_LINE_SIZE];
+				entry.format(line, sizeof(line));
+				handled.push_back(line);
+				host::advanceMicros(300);
+			}
+		});
+
+		std::vector<string> burst;
+		for (int i = 1; i <= 10; ++i) {
+			burst.push_back("*VOL=" + std::to_string(i) + "#");
+			burstSim.sendNoise(burst.back().c_str());
+		}
+
+		std::vector<int> perLoop;
+		while (handled.size() < burst.size() && perLoop.size() < 10) {
+			size_t before = handled.size();
+			bridge.loop();
+			perLoop.push_back(handled.size() - before);
+		}
+
+		float framesPerLoop;
+		int maxFramesPerLoop;
+		long budgetOverruns;
+		bridge.getRecvLoopStats(framesPerLoop, maxFramesPerLoop, budgetOverruns);
+		printf("  %-44s %6zu\n", "loops to handle a burst of 10 frames", perLoop.size());
+		printf("  %-44s %6d\n", "most frames handled in one loop", maxFramesPerLoop);
+		printf("  %-44s %6ld\n", "receive budget overruns", budgetOverruns);
+		check("burst handled over several loops", budgetOverruns > 0 && maxFramesPerLoop > 1 && perLoop.size() > 1);
+		check("each loop stops once it's over budget", maxFramesPerLoop <= 4);
+		check("every frame of the burst handled, in order", handled == burst);
+
+		host::setMicros(savedMicros);
+	}
+
+	printf("reboot while cooling down\n");
+	{
+		// a bridge of its own again, on sectors of its own; the projector carries on through the
+		// reboot, and only the bridge starts again
+		uint64_t savedMicros = host::getMicros();
+		const uint32_t firstSector = 8;
+
+		SimulatedProjector::Config config;
+		config.startOn = true;
+		SimulatedProjector coolingSim(config);
+		// as runUntil()
+		auto runBridge = [](BenQProjector &bridge, Scheduler &wheel, std::function<bool()> until, unsigned long timeoutMs) {
+			unsigned long ms = 0;
+			for (; ms < timeoutMs && !until(); ++ms) {
+				bridge.loop();
+				wheel.loop();
+				host::advanceMillis(1);
+			}
+			return until() ? (long)ms : -1;
+		};
+
+		{
+			Scheduler wheel;
+			StateStore store(logger, wheel, firstSector, STATE_STORE_SECTORS);
+			BenQProjector before(logger, wheel, store, coolingSim, coolingSim, 3);
+			before.begin();
+			runBridge(before, wheel, [&]() { return before.isOn(); }, 5000);
+			before.turnOff();
+			runBridge(before, wheel, [&]() { return strcmp(before.getStatusStr(), "Powering off...") == 0; }, 5000);
+			store.flush();
+		}
+		check("projector still cooling down as the bridge restarts", coolingSim.getPowerPhase() == SimulatedProjector::COOLING_DOWN);
+
+		Scheduler wheel;
+		StateStore store(logger, wheel, firstSector, STATE_STORE_SECTORS);
+		BenQProjector rebooted(logger, wheel, store, coolingSim, coolingSim, 3);
+		PowerState power(logger, wheel, rebooted, 10 * 60, 6 * 60 * 60, 5 * 60, 2 * 60, 2 * 60 * 60);
+		rebooted.begin();
+		power.begin();
+		check("bridge reports off straight after the reboot", !rebooted.isOn() && strcmp(rebooted.getStatusStr(), "Powering off...") == 0);
+
+		// (the simulated projector won't say, but some say they're on until they're done cooling down)
+		coolingSim.sendNoise("*POW=ON#");
+		check("projector saying it's on while cooling down not believed",
+			runBridge(rebooted, wheel, [&]() { return rebooted.isInitialized(); }, 1000) >= 0 && !rebooted.isOn());
+		check("power on refused straight after the reboot", !power.requestPowerOn());
+
+		report("bridge sees the end of the cool-down", runBridge(rebooted, wheel, [&]() { return strcmp(rebooted.getStatusStr(), "Off") == 0; }, 5 * 60 * 1000));
+		check("power on refused within the minimum off time", !power.requestPowerOn());
+		runBridge(rebooted, wheel, [&]() { return millis() - rebooted.getLastOffTime() > 5 * 60 * 1000; }, 10 * 60 * 1000);
+		check("power on allowed once the minimum off time has passed", power.requestPowerOn());
+
+		host::setMicros(savedMicros);
+	}
+
+	printf("state store, on sectors of its own\n");
+	{
+		const uint32_t firstSector = 16;
+		Scheduler wheel;
+		StateStore store(logger, wheel, firstSector, STATE_STORE_SECTORS);
+		uint32_t value = 0;
+		check("nothing to load from erased flash", !store.load(1, &value, sizeof(value)));
+
+		auto loadNewest = [&](uint16_t version, uint32_t &loaded) {
+			StateStore rebooted(logger, wheel, firstSector, STATE_STORE_SECTORS);
+			return rebooted.load(version, &loaded, sizeof(loaded));
+		};
+
+		// every lap writes each slot once, and so erases each sector once
+		int slots = store.getSlotCount();
+		bool erasedOncePerLap = true, newestAfterEveryLap = true;
+		for (int lap = 1; lap <= 3; ++lap) {
+			for (int i = 0; i < slots; ++i) {
+				value++;
+				store.save(1, &value, sizeof(value));
+				store.flush();
+			}
+			uint32_t loaded;
+			erasedOncePerLap = erasedOncePerLap && store.getErases() == lap * STATE_STORE_SECTORS;
+			newestAfterEveryLap = newestAfterEveryLap && loadNewest(1, loaded) && loaded == value;
+		}
+		printf("  %-44s %6ld\n", "writes over 3 laps", store.getWrites());
+		printf("  %-44s %6ld\n", "sectors erased", store.getErases());
+		check("every write goes in a slot of its own", store.getWrites() == 3 * slots);
+		check("each sector erased once per lap", erasedOncePerLap);
+		check("newest record loaded after every lap", newestAfterEveryLap);
+
+		// (the next slot is the first of its sector, and so erased when it's written)
+		uint32_t saved = ++value;
+		store.save(1, &value, sizeof(value));
+		store.flush();
+		store.save(1, &++value, sizeof(value));
+		store.flush();
+		uint32_t crc = 0;
+		ESP.flashWrite(store.getSlotAddress(1) + offsetof(StateStore::Slot, crc), &crc, sizeof(crc));
+		uint32_t loaded;
+		check("record with a bad CRC passed over", loadNewest(1, loaded) && loaded == saved);
+
+		// a write cut short by losing power, after the newest good record
+		StateStore afterBadCrc(logger, wheel, firstSector, STATE_STORE_SECTORS);
+		afterBadCrc.load(1, &loaded, sizeof(loaded));
+		StateStore::Slot half;
+		ESP.flashRead(store.getSlotAddress(0), (uint32_t *)&half, sizeof(half));
+		half.sequence += 2;
+		memcpy(half.data, &++value, sizeof(value));
+		ESP.flashWrite(store.getSlotAddress(2), (uint32_t *)&half, sizeof(half) / 2);
+		check("half written record passed over", loadNewest(1, loaded) && loaded == saved);
+
+		afterBadCrc.save(1, &++value, sizeof(value));
+		afterBadCrc.flush();
+		check("slots that aren't free are written around", loadNewest(1, loaded) && loaded == value &&
+			afterBadCrc.getWrites() == 1 && afterBadCrc.getErases() == 0);
+
+		check("record of another version not loaded", !loadNewest(2, loaded) && loaded == 0);
+
+		// a record whose sequence number is about to wrap, laid down by hand in sectors of its own
+		const uint32_t wrapSector = firstSector + STATE_STORE_SECTORS;
+		StateStore::Slot wrapping;
+		memset(&wrapping, 0, sizeof(wrapping));
+		wrapping.magic = StateStore::SLOT_MAGIC;
+		wrapping.sequence = 0xFFFFFFFE;
+		wrapping.version = 1;
+		wrapping.length = sizeof(value);
+		memcpy(wrapping.data, &++value, sizeof(value));
+		wrapping.crc = crc32Checksum(&wrapping, offsetof(StateStore::Slot, crc));
+		ESP.flashEraseSector(wrapSector);
+		ESP.flashWrite(wrapSector * SPI_FLASH_SEC_SIZE, (uint32_t *)&wrapping, sizeof(wrapping));
+
+		bool newestAcrossWrap = true;
+		for (int i = 0; i < 3; ++i) {
+			StateStore acrossWrap(logger, wheel, wrapSector, STATE_STORE_SECTORS);
+			newestAcrossWrap = newestAcrossWrap && acrossWrap.load(1, &loaded, sizeof(loaded)) && loaded == value;
+			acrossWrap.save(1, &++value, sizeof(value));
+			acrossWrap.flush();
+		}
+		StateStore afterWrap(logger, wheel, wrapSector, STATE_STORE_SECTORS);
+		check("newest record loaded as the sequence number wraps", newestAcrossWrap && afterWrap.load(1, &loaded, sizeof(loaded)) && loaded == value);
+	}
+
+	printf("timers\n");
+	{
+		printf("  %-44s %6ld\n", "callbacks run", scheduler.getFiredCount());
+		check("timer callbacks only run when due", scheduler.getFiredCount() < loopStats.iterations / 100);
+		unsigned long wake;
+		check("next wake reported", scheduler.getNextWake(wake) && wake - millis() <= 3 * 1000 * 11 / 10);
+
+		// millis() wrapping, on a scheduler of its own; the clock goes back afterwards, and nothing
+		// else runs in between
+		uint64_t savedMicros = host::getMicros();
+		host::setMicros(((1ull << 32) - 100) * 1000);
+
+		Scheduler wheel;
+		std::vector<std::pair<string, unsigned long>> fired;
+		int repeats = 0;
+		int before = wheel.add("before", [&]() { fired.push_back({ "before", millis() }); });
+		int across = wheel.add("across", [&]() { fired.push_back({ "across", millis() }); });
+		int cancelled = wheel.add("cancelled", [&]() { fired.push_back({ "cancelled", millis() }); });
+		int repeating = -1;
+		repeating = wheel.add("repeating", [&]() {
+			fired.push_back({ "repeating", millis() });
+			if (++repeats < 5) {
+				wheel.after(repeating, 70);
+			}
+		});
+
+		wheel.after(before, 50);
+		wheel.after(across, 150);
+		wheel.after(cancelled, 120);
+		wheel.after(repeating, 30);
+		for (int ms = 0; ms < 400; ++ms) {
+			if (ms == 110) {
+				wheel.cancel(cancelled);
+			}
+			wheel.loop();
+			host::advanceMillis(1);
+		}
+		host::setMicros(savedMicros);
+
+		std::vector<std::pair<string, unsigned long>> expected = {
+			{ "repeating", 4294967226 }, { "before", 4294967246 }, { "repeating", 0 },
+			{ "across", 50 }, { "repeating", 70 }, { "repeating", 140 }, { "repeating", 210 },
+		};
+		check("timers go off on time across millis() wrapping", fired == expected);
+	}
+
+	auto finalStatus = httpServer.request(HTTP_GET, "/status");
+	printf("final /status: %d %s\n", finalStatus.code, finalStatus.body.c_str());
+
+	long sent, received;
+	int count10s, count60s, count360s;
+	float rate10s, rate60s, rate360s;
+	projector.getSendStats(sent, count10s, count60s, count360s, rate10s, rate60s, rate360s);
+	projector.getRecvStats(received, count10s, count60s, count360s, rate10s, rate60s, rate360s);
+
+	printf("traffic\n");
+	printf("  %-44s %6ld\n", "commands sent by bridge", sent);
+	printf("  %-44s %6ld\n", "frames received by bridge", received);
+	printf("  %-44s %6ld\n", "commands accepted by projector", sim.getCommandCount());
+	printf("  %-44s %6ld\n", "commands lost (projector busy)", sim.getDroppedCount());
+	printf("  %-44s %6ld\n", "commands during 5 min idle (off)", idleCommands);
+
+	// the 1m window slides a 6s bucket at a time, so it covers somewhere between 54s and 60s
+	auto acceptedSince = [](unsigned long since) {
+		return std::count_if(wire.begin(), wire.end(), [since](const std::pair<unsigned long, string> &sent) { return sent.first >= since; });
+	};
+	projector.getSendStats(sent, count10s, count60s, count360s, rate10s, rate60s, rate360s);
+	printf("  %-44s %6d (%ld-%ld)\n", "commands sent in the last minute", count60s, acceptedSince(millis() - 54000), acceptedSince(millis() - 60000));
+	check("1m count slides with the traffic", count60s >= acceptedSince(millis() - 54000) && count60s <= acceptedSince(millis() - 60000));
+
+	float framesPerLoop;
+	int maxFramesPerLoop;
+	long budgetOverruns;
+	projector.getRecvLoopStats(framesPerLoop, maxFramesPerLoop, budgetOverruns);
+	printf("  %-44s %9.1f\n", "frames handled per receiving loop", framesPerLoop);
+	printf("  %-44s %6d\n", "most frames handled in one loop", maxFramesPerLoop);
+	printf("  %-44s %6ld\n", "receive budget overruns", budgetOverruns);
+
+	long duplicateQueries, replacedSetters;
+	projector.getCoalesceStats(duplicateQueries, replacedSetters);
+	printf("  %-44s %6ld\n", "duplicate queries coalesced", duplicateQueries);
+	printf("  %-44s %6ld\n", "pending setters replaced", replacedSetters);
+	printf("  %-44s %6zu\n", "MQTT status publishes", statusPublications().size());
+	printf("  %-44s %6ld\n", "status serializations", status.getSerializations());
+
+	float responseTime;
+	int timeout, gap;
+	long timeouts;
+	projector.getPacingStats(responseTime, timeout, gap, timeouts);
+	printf("send pacing\n");
+	printf("  %-44s %9.1f ms\n", "smoothed response time", responseTime);
+	printf("  %-44s %6d ms\n", "response timeout", timeout);
+	printf("  %-44s %6d ms\n", "gap after response", gap);
+	printf("  %-44s %6ld\n", "timeouts", timeouts);
+
+	printf("loop cost (host CPU)\n");
+	printf("  %-44s %6ld\n", "iterations", loopStats.iterations);
+	printf("  %-44s %9.1f ns\n", "mean main loop iteration", loopStats.totalNanos / loopStats.iterations);
+	printf("  %-44s %9.1f ns\n", "mean BenQProjector::loop()", loopStats.projectorNanos / loopStats.iterations);
+	printf("  %-44s %9.1f ns\n", "max main loop iteration", loopStats.maxNanos);
+
+	if (failures > 0) {
+		printf("%d check(s) failed\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
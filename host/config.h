@@ -0,0 +1,28 @@
+// Configuration for the host build; mirrors config.h.sample with the board-only bits dropped.
+// HomeKit isn't part of the host build, so it stays disabled here.
+
+#define SERIAL_BAUD_RATE 115200
+
+#define CLIENT_NAME "BenQ-Bridge-Host"
+
+#define ENABLE_MQTT
+
+#define MQTT_SERVER "localhost"
+#define MQTT_SERVER_PORT 1883
+#define MQTT_USERNAME NULL
+#define MQTT_PASSWORD NULL
+
+#define MQTT_STATUS_INTERVAL 60000
+
+#define MQTT_SET_POWER_TOPIC "room/projector/power/set"
+#define MQTT_SET_VOLUME_TOPIC "room/projector/volume/set"
+#define MQTT_SET_SOURCE_TOPIC "room/projector/source/set"
+#define MQTT_SET_LAMP_MODE_TOPIC "room/projector/lampmode/set"
+#define MQTT_RAW_COMMAND_TOPIC "room/projector/raw/send"
+#define MQTT_REMOTE_COMMAND_TOPIC "room/projector/hk-remote/set"
+#define MQTT_STATUS_TOPIC "room/projector/status"
+#define MQTT_STATS_TOPIC "room/projector/stats"
+
+#define ENABLE_HTTP
+
+#define HTTP_PORT 80
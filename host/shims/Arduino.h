@@ -0,0 +1,87 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+/**
+ * Host stand-in for the bits of the ESP8266 Arduino core that the bridge uses. Time is virtual:
+ * millis() and micros() only move when the host program advances the clock, which keeps every run
+ * deterministic regardless of how fast the host machine is.
+ */
+
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <strings.h>
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+
+namespace host {
+	// virtual clock controls; millis() wraps at 32 bits just like it does on the ESP8266
+	void setMicros(uint64_t micros);
+	void advanceMicros(uint64_t micros);
+	void advanceMillis(uint64_t millis);
+	uint64_t getMicros();
+
+	// keeps the flash behind ESP.flashRead() and friends in a file (created erased if it doesn't
+	// exist), so it outlasts the program; otherwise it's in memory. False if it can't be opened
+	bool setFlashFile(const char *path);
+}
+
+// the ESP8266's flash erases a sector at a time
+#define SPI_FLASH_SEC_SIZE 4096
+
+/**
+ * Just enough of Arduino's String for the code that gets compiled on the host.
+ */
+class String {
+public:
+	String() {}
+	String(const char *str) : value(str != nullptr ? str : "") {}
+	String(const std::string &str) : value(str) {}
+	String(int val) : value(std::to_string(val)) {}
+	String(unsigned int val) : value(std::to_string(val)) {}
+	String(long val) : value(std::to_string(val)) {}
+	String(unsigned long val) : value(std::to_string(val)) {}
+
+	const char *c_str() const { return value.c_str(); }
+	unsigned int length() const { return value.length(); }
+	bool equals(const String &other) const { return value == other.value; }
+	bool equalsIgnoreCase(const String &other) const { return strcasecmp(value.c_str(), other.c_str()) == 0; }
+	bool operator==(const String &other) const { return value == other.value; }
+	bool operator!=(const String &other) const { return value != other.value; }
+	String &operator+=(const String &other) { value += other.value; return *this; }
+
+private:
+	std::string value;
+};
+
+class EspClass {
+public:
+	uint32_t getChipId() { return 0x00BE4A00; }
+	uint32_t getFreeHeap() { return freeHeap; }
+	uint32_t getMaxFreeBlockSize() { return freeHeap; }
+	uint8_t getHeapFragmentation() { return 0; }
+
+	// like NOR flash, an erase sets every bit of the sector and a write can only clear bits
+	bool flashEraseSector(uint32_t sector);
+	bool flashWrite(uint32_t address, uint32_t *data, size_t size);
+	bool flashRead(uint32_t address, uint32_t *data, size_t size);
+
+	// host-only; lets a simulation pretend heap is being consumed
+	void setFreeHeap(uint32_t heap) { freeHeap = heap; }
+
+private:
+	uint32_t freeHeap = 40 * 1024;
+};
+
+extern EspClass ESP;
+
+#include "HardwareSerial.h"
+
+#endif
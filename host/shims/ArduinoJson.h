@@ -0,0 +1,102 @@
+#ifndef HOST_ARDUINO_JSON_H
+#define HOST_ARDUINO_JSON_H
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Host stand-in for the sliver of ArduinoJson the bridge uses: a flat object of scalar members,
+ * serialized in insertion order.
+ */
+class JsonDocument {
+public:
+	class MemberProxy {
+	public:
+		MemberProxy(JsonDocument &doc, const char *key) : doc(doc), key(key) {}
+
+		MemberProxy &operator=(bool value) { return set(value ? "true" : "false"); }
+		MemberProxy &operator=(int value) { return set(std::to_string(value)); }
+		MemberProxy &operator=(long value) { return set(std::to_string(value)); }
+		MemberProxy &operator=(unsigned int value) { return set(std::to_string(value)); }
+		MemberProxy &operator=(unsigned long value) { return set(std::to_string(value)); }
+		MemberProxy &operator=(float value) { return operator=((double)value); }
+		MemberProxy &operator=(double value) {
+			char formatted[32];
+			snprintf(formatted, sizeof(formatted), "%g", value);
+			return set(formatted);
+		}
+		MemberProxy &operator=(const char *value) {
+			if (value == nullptr) {
+				return set("null");
+			}
+
+			std::string quoted = "\"";
+			for (const char *c = value; *c; ++c) {
+				if (*c == '"' || *c == '\\') {
+					quoted += '\\';
+				}
+				quoted += *c;
+			}
+			return set(quoted + "\"");
+		}
+
+	private:
+		JsonDocument &doc;
+		const char *key;
+
+		MemberProxy &set(const std::string &encoded) {
+			for (auto &member : doc.members) {
+				if (member.first == key) {
+					member.second = encoded;
+					return *this;
+				}
+			}
+
+			doc.members.push_back({ key, encoded });
+			return *this;
+		}
+	};
+
+	MemberProxy operator[](const char *key) { return MemberProxy(*this, key); }
+
+	void clear() { members.clear(); }
+	size_t size() const { return members.size(); }
+
+	std::string encode() const {
+		std::string out = "{";
+		for (auto &member : members) {
+			if (out.size() > 1) {
+				out += ",";
+			}
+			out += "\"" + member.first + "\":" + member.second;
+		}
+		return out + "}";
+	}
+
+private:
+	std::vector<std::pair<std::string, std::string>> members;
+};
+
+template<size_t capacity> class StaticJsonDocument : public JsonDocument {
+};
+
+inline size_t measureJson(const JsonDocument &doc) {
+	return doc.encode().size();
+}
+
+inline size_t serializeJson(const JsonDocument &doc, char *output, size_t size) {
+	if (size == 0) {
+		return 0;
+	}
+
+	std::string encoded = doc.encode();
+	size_t written = encoded.size() < size ? encoded.size() : size - 1;
+	memcpy(output, encoded.data(), written);
+	output[written] = 0;
+	return written;
+}
+
+#endif
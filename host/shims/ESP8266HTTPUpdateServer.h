@@ -0,0 +1,16 @@
+#ifndef HOST_ESP8266_HTTP_UPDATE_SERVER_H
+#define HOST_ESP8266_HTTP_UPDATE_SERVER_H
+
+#include <ESP8266WebServer.h>
+
+/**
+ * Host stand-in for the OTA updater; there's nothing to flash on the host, so it does nothing.
+ */
+class ESP8266HTTPUpdateServer {
+public:
+	ESP8266HTTPUpdateServer(bool serialDebugging = false) { (void)serialDebugging; }
+
+	void setup(ESP8266WebServer *server, const char *path = "/update") { (void)server; (void)path; }
+};
+
+#endif
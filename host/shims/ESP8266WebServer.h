@@ -0,0 +1,172 @@
+#ifndef HOST_ESP8266_WEB_SERVER_H
+#define HOST_ESP8266_WEB_SERVER_H
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+
+#include "alloc_counter.hpp"
+
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define CONTENT_LENGTH_UNKNOWN ((size_t)-1)
+
+enum HTTPMethod { HTTP_ANY, HTTP_GET, HTTP_HEAD, HTTP_POST, HTTP_PUT, HTTP_PATCH, HTTP_DELETE, HTTP_OPTIONS };
+
+/**
+ * Host stand-in for ESP8266WebServer. There is no socket; the host program calls request() to run
+ * a handler and gets back whatever the handler sent, including how the body was chunked and how
+ * much heap the handler needed on top of what was allocated before it ran.
+ */
+class ESP8266WebServer {
+public:
+	typedef std::function<void(void)> THandlerFunction;
+
+	struct Response {
+		int code = 0;
+		std::string contentType;
+		std::vector<std::pair<std::string, std::string>> headers;
+		std::string body;
+
+		bool chunked = false;
+		int chunks = 0;
+		size_t peakHeap = 0;
+
+		// the connection the request came in on, which a handler may have kept
+		WiFiClient client;
+
+		std::string header(const std::string &name) const {
+			for (auto &header : headers) {
+				if (header.first == name) {
+					return header.second;
+				}
+			}
+			return "";
+		}
+	};
+
+	ESP8266WebServer(int port = 80) {
+		(void)port;
+		latest() = this;
+	}
+
+	void begin() {}
+	void handleClient() {}
+
+	void on(const String &uri, HTTPMethod method, THandlerFunction handler) {
+		routes.push_back({ uri.c_str(), method, handler });
+	}
+
+	void send(int code, const char *contentType = nullptr, const String &content = String("")) {
+		response.code = code;
+		response.contentType = contentType != nullptr ? contentType : "";
+		response.chunked = contentLength == CONTENT_LENGTH_UNKNOWN;
+		response.body.append(content.c_str());
+	}
+
+	void setContentLength(size_t length) {
+		contentLength = length;
+	}
+
+	void sendContent(const char *content, size_t size) {
+		if (response.chunked && size > 0) {
+			response.chunks++;
+		}
+		response.body.append(content, size);
+	}
+
+	void sendContent(const String &content) {
+		sendContent(content.c_str(), content.length());
+	}
+
+	void sendHeader(const String &name, const String &value, bool first = false) {
+		(void)first;
+		response.headers.push_back({ name.c_str(), value.c_str() });
+	}
+
+	bool hasArg(const String &name) {
+		return args.count(name.c_str()) > 0;
+	}
+
+	String arg(const String &name) {
+		auto found = args.find(name.c_str());
+		return found != args.end() ? String(found->second) : String("");
+	}
+
+	// like the real one, only headers named here are kept from a request
+	void collectHeaders(const char *headerKeys[], const size_t headerKeysCount) {
+		collected.assign(headerKeys, headerKeys + headerKeysCount);
+	}
+
+	bool hasHeader(const String &name) {
+		return headers.count(name.c_str()) > 0;
+	}
+
+	String header(const String &name) {
+		auto found = headers.find(name.c_str());
+		return found != headers.end() ? String(found->second) : String("");
+	}
+
+	WiFiClient client() {
+		return response.client;
+	}
+
+	// host-only; the most recently constructed server, so host programs can reach one owned by
+	// HttpSupport
+	static ESP8266WebServer *&latest() {
+		static ESP8266WebServer *instance = nullptr;
+		return instance;
+	}
+
+	// host-only; runs the matching handler and returns what it sent (404 if nothing matched)
+	Response request(HTTPMethod method, const char *uri, std::map<std::string, std::string> requestArgs = {},
+		std::map<std::string, std::string> requestHeaders = {}) {
+		response = Response();
+		response.client = WiFiClient::open();
+		args = requestArgs;
+
+		headers.clear();
+		for (auto &name : collected) {
+			auto found = requestHeaders.find(name);
+			if (found != requestHeaders.end()) {
+				headers[name] = found->second;
+			}
+		}
+		contentLength = 0;
+
+		// room for the body up front, so that capturing it doesn't count against the handler
+		response.body.reserve(64 * 1024);
+
+		for (auto &route : routes) {
+			if (route.uri == uri && (route.method == HTTP_ANY || route.method == method)) {
+				size_t before = host::getLiveBytes();
+				host::resetPeakLiveBytes();
+				route.handler();
+				response.peakHeap = host::getPeakLiveBytes() - before;
+				return response;
+			}
+		}
+
+		response.code = 404;
+		return response;
+	}
+
+private:
+	struct Route {
+		std::string uri;
+		HTTPMethod method;
+		THandlerFunction handler;
+	};
+
+	std::vector<Route> routes;
+	std::map<std::string, std::string> args;
+	std::vector<std::string> collected;
+	std::map<std::string, std::string> headers;
+	size_t contentLength = 0;
+	Response response;
+};
+
+#endif
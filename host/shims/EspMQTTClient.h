@@ -0,0 +1,122 @@
+#ifndef HOST_ESP_MQTT_CLIENT_H
+#define HOST_ESP_MQTT_CLIENT_H
+
+#include <Arduino.h>
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * Host stand-in for EspMQTTClient. There is no broker; the "connection" comes up on the first
+ * loop() and the host program can inject messages, force reconnects and inspect what was
+ * published.
+ */
+class EspMQTTClient {
+public:
+	typedef std::function<void()> ConnectionEstablishedCallback;
+	typedef std::function<void(const String &message)> MessageReceivedCallback;
+	typedef std::function<void()> DelayedExecutionCallback;
+
+	struct Publication {
+		std::string topic, payload;
+		bool retain;
+		unsigned long at;
+	};
+
+	EspMQTTClient(const char *server, const short port, const char *username, const char *password, const char *clientName) {
+		(void)server; (void)port; (void)username; (void)password; (void)clientName;
+		latest() = this;
+	}
+
+	void setOnConnectionEstablishedCallback(ConnectionEstablishedCallback callback) {
+		connectionEstablished = callback;
+	}
+
+	void enableDebuggingMessages(const bool enabled = true) { (void)enabled; }
+
+	bool isConnected() const { return connected; }
+
+	bool subscribe(const String &topic, MessageReceivedCallback callback, uint8_t qos = 0) {
+		(void)qos;
+		subscriptions[topic.c_str()] = callback;
+		return true;
+	}
+
+	bool publish(const String &topic, const String &payload, bool retain = false) {
+		if (!connected) {
+			return false;
+		}
+
+		publications.push_back({ topic.c_str(), payload.c_str(), retain, millis() });
+		return true;
+	}
+
+	void executeDelayed(const unsigned long delay, DelayedExecutionCallback callback) {
+		delayed.push_back({ millis() + delay, callback });
+	}
+
+	void loop() {
+		if (!connected) {
+			connected = true;
+			connectionCount++;
+
+			if (connectionEstablished) {
+				connectionEstablished();
+			}
+		}
+
+		unsigned long now = millis();
+		for (size_t i = 0; i < delayed.size();) {
+			if ((long)(now - delayed[i].at) >= 0) {
+				auto callback = delayed[i].callback;
+				delayed.erase(delayed.begin() + i);
+				callback();
+			} else {
+				++i;
+			}
+		}
+	}
+
+	// host-only helpers
+
+	// the most recently constructed client, so host programs can reach one owned by MqttSupport
+	static EspMQTTClient *&latest() {
+		static EspMQTTClient *instance = nullptr;
+		return instance;
+	}
+
+	void inject(const char *topic, const char *payload) {
+		auto subscription = subscriptions.find(topic);
+		if (connected && subscription != subscriptions.end()) {
+			subscription->second(String(payload));
+		}
+	}
+
+	void dropConnection() {
+		// subscriptions don't survive a reconnect, but delayed executions do
+		connected = false;
+		subscriptions.clear();
+	}
+
+	int getConnectionCount() const { return connectionCount; }
+	size_t getPendingDelayedCount() const { return delayed.size(); }
+	const std::vector<Publication> &getPublications() const { return publications; }
+	void clearPublications() { publications.clear(); }
+
+private:
+	struct Delayed {
+		unsigned long at;
+		DelayedExecutionCallback callback;
+	};
+
+	bool connected = false;
+	int connectionCount = 0;
+	ConnectionEstablishedCallback connectionEstablished;
+	std::map<std::string, MessageReceivedCallback> subscriptions;
+	std::vector<Delayed> delayed;
+	std::vector<Publication> publications;
+};
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef HOST_HARDWARE_SERIAL_H
+#define HOST_HARDWARE_SERIAL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Host stand-in for the Print/Stream/HardwareSerial hierarchy. Unlike the real core class, this
+ * HardwareSerial is abstract; the host build plugs in something that plays the far end of the
+ * wire (see SimulatedProjector).
+ */
+class Print {
+public:
+	virtual ~Print() {}
+
+	virtual size_t write(uint8_t c) = 0;
+
+	virtual size_t write(const uint8_t *buffer, size_t size) {
+		size_t written = 0;
+		while (size--) {
+			written += write(*buffer++);
+		}
+		return written;
+	}
+
+	size_t print(const char *str) { return write((const uint8_t *)str, strlen(str)); }
+	size_t print(char c) { return write((uint8_t)c); }
+	size_t println(const char *str) { return print(str) + print("\r\n"); }
+	size_t println() { return print("\r\n"); }
+};
+
+class Stream : public Print {
+public:
+	virtual int available() = 0;
+	virtual int read() = 0;
+	virtual int peek() = 0;
+};
+
+class HardwareSerial : public Stream {
+public:
+	virtual void begin(unsigned long baud) { (void)baud; }
+};
+
+#endif
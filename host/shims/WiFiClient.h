@@ -0,0 +1,81 @@
+#ifndef HOST_WIFI_CLIENT_H
+#define HOST_WIFI_CLIENT_H
+
+#include <Arduino.h>
+
+#include <memory>
+#include <string>
+
+/**
+ * Host stand-in for WiFiClient. Like the real one, copies share the same connection. There is no
+ * socket: whatever is written piles up in the connection's send window until the host program
+ * reads it back with take(), and writing more than availableForWrite() (which would block on the
+ * ESP8266) is counted as a stall.
+ */
+class WiFiClient {
+public:
+	WiFiClient() {}
+
+	uint8_t connected() { return connection != nullptr && connection->open; }
+	explicit operator bool() { return connected(); }
+
+	size_t availableForWrite() {
+		return connected() ? connection->window - connection->unread.size() : 0;
+	}
+
+	size_t write(const uint8_t *buf, size_t size) {
+		if (!connected()) {
+			return 0;
+		}
+		if (size > availableForWrite()) {
+			connection->stalls++;
+		}
+		connection->unread.append((const char *)buf, size);
+		return size;
+	}
+
+	size_t write(const char *buf, size_t size) { return write((const uint8_t *)buf, size); }
+
+	void setNoDelay(bool noDelay) { (void)noDelay; }
+
+	void stop() {
+		if (connection != nullptr) {
+			connection->open = false;
+		}
+	}
+
+	// host-only; a new connection whose peer reads at most `window` bytes behind the writer
+	static WiFiClient open(size_t window = 2920) {
+		WiFiClient client;
+		client.connection = std::make_shared<Connection>();
+		client.connection->window = window;
+		return client;
+	}
+
+	// host-only; the peer reads everything written so far
+	std::string take() {
+		std::string read;
+		if (connection != nullptr) {
+			read.swap(connection->unread);
+		}
+		return read;
+	}
+
+	// host-only; the peer hangs up
+	void hangUp() { stop(); }
+
+	// host-only; writes that would have blocked on the ESP8266
+	long getStalls() { return connection != nullptr ? connection->stalls : 0; }
+
+private:
+	struct Connection {
+		bool open = true;
+		size_t window = 0;
+		std::string unread;
+		long stalls = 0;
+	};
+
+	std::shared_ptr<Connection> connection;
+};
+
+#endif
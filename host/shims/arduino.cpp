@@ -0,0 +1,106 @@
+#include <Arduino.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+EspClass ESP;
+
+static uint64_t clockMicros = 0;
+
+unsigned long millis() {
+	return (uint32_t)(clockMicros / 1000);
+}
+
+unsigned long micros() {
+	return (uint32_t)clockMicros;
+}
+
+void delay(unsigned long ms) {
+	// nothing else runs on the host, so a delay is just the clock moving forward
+	clockMicros += (uint64_t)ms * 1000;
+}
+
+void yield() {
+}
+
+namespace host {
+	void setMicros(uint64_t micros) { clockMicros = micros; }
+	void advanceMicros(uint64_t micros) { clockMicros += micros; }
+	void advanceMillis(uint64_t millis) { clockMicros += millis * 1000; }
+	uint64_t getMicros() { return clockMicros; }
+}
+
+// the flash, when it isn't in a file
+static std::vector<uint8_t> flashMemory;
+static FILE *flashFile = nullptr;
+
+namespace host {
+	bool setFlashFile(const char *path) {
+		FILE *file = fopen(path, "r+b");
+		if (file == nullptr) {
+			file = fopen(path, "w+b");
+		}
+		if (file == nullptr) {
+			return false;
+		}
+
+		if (flashFile != nullptr) {
+			fclose(flashFile);
+		}
+		flashFile = file;
+		return true;
+	}
+}
+
+// anything past the end of the file (or memory) hasn't been written since it was erased
+static void readFlash(uint32_t address, uint8_t *bytes, size_t size) {
+	memset(bytes, 0xff, size);
+
+	if (flashFile != nullptr) {
+		fseek(flashFile, address, SEEK_SET);
+		fread(bytes, 1, size, flashFile);
+	} else if (address < flashMemory.size()) {
+		memcpy(bytes, flashMemory.data() + address, std::min(size, flashMemory.size() - address));
+	}
+}
+
+static void writeFlash(uint32_t address, const uint8_t *bytes, size_t size) {
+	if (flashFile != nullptr) {
+		// (a file extended past its end by seeking reads back as zeros, so fill any gap first)
+		fseek(flashFile, 0, SEEK_END);
+		for (long end = ftell(flashFile); end < (long)address; ++end) {
+			fputc(0xff, flashFile);
+		}
+		fseek(flashFile, address, SEEK_SET);
+		fwrite(bytes, 1, size, flashFile);
+		fflush(flashFile);
+	} else {
+		if (flashMemory.size() < address + size) {
+			flashMemory.resize(address + size, 0xff);
+		}
+		memcpy(flashMemory.data() + address, bytes, size);
+	}
+}
+
+bool EspClass::flashEraseSector(uint32_t sector) {
+	std::vector<uint8_t> erased(SPI_FLASH_SEC_SIZE, 0xff);
+	writeFlash(sector * SPI_FLASH_SEC_SIZE, erased.data(), erased.size());
+	return true;
+}
+
+bool EspClass::flashWrite(uint32_t address, uint32_t *data, size_t size) {
+	std::vector<uint8_t> bytes(size);
+	readFlash(address, bytes.data(), size);
+	for (size_t i = 0; i < size; ++i) {
+		bytes[i] &= ((const uint8_t *)data)[i];
+	}
+	writeFlash(address, bytes.data(), size);
+	return true;
+}
+
+bool EspClass::flashRead(uint32_t address, uint32_t *data, size_t size) {
+	readFlash(address, (uint8_t *)data, size);
+	return true;
+}
@@ -0,0 +1,324 @@
+#include "sim_projector.hpp"
+
+#include <Arduino.h>
+
+#include <algorithm>
+
+using std::string;
+
+static string toUpper(string str) {
+	std::transform(str.begin(), str.end(), str.begin(), [](unsigned char c) { return toupper(c); });
+	return str;
+}
+
+static string toLower(string str) {
+	std::transform(str.begin(), str.end(), str.begin(), [](unsigned char c) { return tolower(c); });
+	return str;
+}
+
+static bool isOneOf(const string &value, std::initializer_list<const char *> options) {
+	for (auto option : options) {
+		if (value == option) {
+			return true;
+		}
+	}
+	return false;
+}
+
+SimulatedProjector::SimulatedProjector() : SimulatedProjector(Config()) {
+}
+
+SimulatedProjector::SimulatedProjector(const Config &config) : config(config) {
+	state.volume = config.volume;
+
+	if (config.startOn) {
+		state.phase = POWER_ON;
+	}
+}
+
+void SimulatedProjector::setLoseEvery(int n) {
+	loseEvery = n;
+	sinceLost = 0;
+}
+
+void SimulatedProjector::sendNoise(const char *line) {
+	output.push_back({ millis(), string(line) + config.lineEnding });
+}
+
+void SimulatedProjector::onCommand(std::function<void(const char *, unsigned long)> listener) {
+	commandListener = listener;
+}
+
+int SimulatedProjector::available() {
+	advance();
+
+	unsigned long now = millis();
+	int count = 0;
+	size_t skip = outputIdx;
+
+	for (auto &pending : output) {
+		if ((long)(now - pending.at) < 0) {
+			break;
+		}
+
+		count += pending.bytes.size() - skip;
+		skip = 0;
+	}
+
+	return count;
+}
+
+int SimulatedProjector::peek() {
+	if (available() == 0) {
+		return -1;
+	}
+
+	return (unsigned char)output.front().bytes[outputIdx];
+}
+
+int SimulatedProjector::read() {
+	int c = peek();
+
+	if (c >= 0 && ++outputIdx == output.front().bytes.size()) {
+		output.pop_front();
+		outputIdx = 0;
+	}
+
+	return c;
+}
+
+size_t SimulatedProjector::write(uint8_t c) {
+	advance();
+
+	if (c == '\r' || c == '\n') {
+		string frame;
+		frame.swap(input);
+		handleFrame(frame);
+	} else {
+		input += (char)c;
+	}
+
+	return 1;
+}
+
+void SimulatedProjector::advance() {
+	unsigned long elapsed = millis() - state.phaseSince;
+
+	if (state.phase == WARMING_UP && elapsed >= config.warmUpMs) {
+		setPhase(POWER_ON);
+	} else if (state.phase == COOLING_DOWN && elapsed >= config.coolDownMs) {
+		setPhase(POWER_OFF);
+	}
+}
+
+void SimulatedProjector::setPhase(PowerPhase phase) {
+	unsigned long now = millis();
+
+	// the lamp is lit from the start of warm-up until cool-down begins
+	if (state.phase == WARMING_UP || state.phase == POWER_ON) {
+		if (phase == COOLING_DOWN || phase == POWER_OFF) {
+			state.onMillis += now - state.phaseSince;
+		}
+	}
+
+	if (phase == POWER_ON && state.phase == WARMING_UP) {
+		// keep counting lamp time from the start of warm-up
+		state.onMillis += now - state.phaseSince;
+	}
+
+	state.phase = phase;
+	state.phaseSince = now;
+}
+
+void SimulatedProjector::handleFrame(const string &frame) {
+	if (frame.empty()) {
+		// bare line terminators are ignored
+		return;
+	}
+
+	unsigned long now = millis();
+
+	if ((long)(now - busyUntil) < 0) {
+		// still working on the last command, so this one is lost
+		droppedCount++;
+		return;
+	}
+
+	if (loseEvery > 0 && ++sinceLost >= loseEvery) {
+		// garbled on the way; the projector never sees it
+		sinceLost = 0;
+		droppedCount++;
+		return;
+	}
+
+	commandCount++;
+	busyUntil = now + config.replyDelayMs;
+	output.push_back({ now + config.echoDelayMs, ">" + frame + config.lineEnding });
+
+	if (frame.size() < 2 || frame.front() != '*' || frame.back() != '#') {
+		reply("Illegal format");
+		return;
+	}
+
+	string body = frame.substr(1, frame.size() - 2);
+
+	if (commandListener) {
+		commandListener(body.c_str(), now);
+	}
+
+	auto split = body.find('=');
+	if (split == string::npos) {
+		handleCommand(toLower(body), "", false);
+	} else {
+		handleCommand(toLower(body.substr(0, split)), toLower(body.substr(split + 1)), true);
+	}
+}
+
+void SimulatedProjector::reply(const string &body) {
+	output.push_back({ millis() + config.replyDelayMs, "*" + body + "#" + config.lineEnding });
+}
+
+bool SimulatedProjector::handleOnOff(const string &key, const string &value, bool &field) {
+	if (value == "on" || value == "off") {
+		field = value == "on";
+	} else if (value != "?") {
+		return false;
+	}
+
+	reply(toUpper(key) + "=" + (field ? "ON" : "OFF"));
+	return true;
+}
+
+void SimulatedProjector::handleCommand(const string &key, const string &value, bool hasValue) {
+	bool lit = state.phase == WARMING_UP || state.phase == POWER_ON;
+
+	if (key == "pow" && hasValue) {
+		if (value == "on") {
+			if (state.phase == COOLING_DOWN) {
+				reply("Block item");
+				return;
+			}
+
+			if (state.phase == POWER_OFF) {
+				setPhase(WARMING_UP);
+			}
+
+			reply("POW=ON");
+		} else if (value == "off") {
+			if (state.phase == WARMING_UP) {
+				reply("Block item");
+				return;
+			}
+
+			if (state.phase == POWER_ON) {
+				setPhase(COOLING_DOWN);
+				state.blanked = state.frozen = false;
+			}
+
+			reply("POW=OFF");
+		} else if (value == "?") {
+			if (state.phase == COOLING_DOWN) {
+				// like mine, which only says it's off once it's done cooling down
+				reply("Block item");
+				return;
+			}
+
+			reply(lit ? "POW=ON" : "POW=OFF");
+		} else {
+			reply("Block item");
+		}
+
+		return;
+	}
+
+	if (key == "ltim" && value == "?") {
+		unsigned long onMillis = state.onMillis;
+		if (lit) {
+			onMillis += millis() - state.phaseSince;
+		}
+
+		reply("LTIM=" + std::to_string(config.lampHours + onMillis / 3600000));
+		return;
+	}
+
+	if ((config.unsupportedKey && key == config.unsupportedKey) ||
+		!isOneOf(key, { "sour", "vol", "mute", "lampm", "blank", "freeze", "ltim", "modelname", "menu", "enter", "up", "down", "left", "right" })) {
+		reply("Unsupported item");
+		return;
+	}
+
+	if (state.phase != POWER_ON) {
+		// everything else needs the projector fully on
+		reply("Block item");
+		return;
+	}
+
+	if (key == "sour" && hasValue) {
+		if (value == "?") {
+			reply("SOUR=" + state.source);
+		} else if (isOneOf(value, { "hdmi", "hdmi2", "rgb", "rgb2", "ypbr", "vid", "svid", "dp" })) {
+			state.source = toUpper(value);
+			reply("SOUR=" + state.source);
+		} else {
+			reply("Block item");
+		}
+	} else if (key == "vol" && hasValue) {
+		if (value == "?") {
+			reply("VOL=" + std::to_string(state.volume));
+		} else if (value == "+" || value == "-") {
+			// volume steps are acknowledged with the step, not the new volume
+			state.volume = std::max(0, std::min(config.maxVolume, state.volume + (value == "+" ? 1 : -1)));
+			reply("VOL=" + value);
+		} else {
+			reply("Block item");
+		}
+	} else if (key == "mute" && hasValue) {
+		if (!handleOnOff(key, value, state.muted)) reply("Block item");
+	} else if (key == "blank" && hasValue) {
+		if (!handleOnOff(key, value, state.blanked)) reply("Block item");
+	} else if (key == "freeze" && hasValue) {
+		if (!handleOnOff(key, value, state.frozen)) reply("Block item");
+	} else if (key == "lampm" && hasValue) {
+		if (value == "?") {
+			reply("LAMPM=" + state.lampMode);
+		} else if (isOneOf(value, { "lnor", "eco", "seco", "dimming", "custom" })) {
+			state.lampMode = toUpper(value);
+			reply("LAMPM=" + state.lampMode);
+		} else {
+			reply("Block item");
+		}
+	} else if (key == "modelname" && value == "?") {
+		reply("MODELNAME=" + string(config.modelName));
+	} else if (isOneOf(key, { "menu", "enter", "up", "down", "left", "right" })) {
+		reply(toUpper(key) + (hasValue ? "=" + toUpper(value) : ""));
+	} else {
+		reply("Block item");
+	}
+}
+
+SimulatedProjector::PowerPhase SimulatedProjector::getPowerPhase() {
+	advance();
+	return state.phase;
+}
+
+bool SimulatedProjector::isOn() { return getPowerPhase() == POWER_ON; }
+const char *SimulatedProjector::getSource() { return state.source.c_str(); }
+int SimulatedProjector::getVolume() { return state.volume; }
+bool SimulatedProjector::isMuted() { return state.muted; }
+const char *SimulatedProjector::getLampMode() { return state.lampMode.c_str(); }
+bool SimulatedProjector::isImageBlanked() { return state.blanked; }
+bool SimulatedProjector::isImageFrozen() { return state.frozen; }
+
+int SimulatedProjector::getLampHours() {
+	advance();
+
+	unsigned long onMillis = state.onMillis;
+	if (state.phase == WARMING_UP || state.phase == POWER_ON) {
+		onMillis += millis() - state.phaseSince;
+	}
+
+	return config.lampHours + onMillis / 3600000;
+}
+
+long SimulatedProjector::getCommandCount() { return commandCount; }
+long SimulatedProjector::getDroppedCount() { return droppedCount; }
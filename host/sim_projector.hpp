@@ -0,0 +1,112 @@
+#ifndef SIM_PROJECTOR_HPP
+#define SIM_PROJECTOR_HPP
+
+#include <HardwareSerial.h>
+
+#include <deque>
+#include <functional>
+#include <string>
+
+/**
+ * A simulated BenQ projector sitting on the far end of the RS232 link. It speaks the `*key=value#`
+ * protocol: every command is echoed back prefixed with `>`, then answered after a short delay with
+ * either the new value, `*Block item#` (projector can't do that right now), `*Unsupported item#`
+ * or `*Illegal format#`.
+ *
+ * Power goes through warm-up and cool-down phases like the real thing; during those, everything
+ * but power (and lamp hours) is blocked, and so is asking about power while cooling down. The projector can only handle one command at a time, so
+ * anything that arrives before it has replied to the previous command is silently lost. That's
+ * the behavior the bridge's send pacing exists to avoid.
+ *
+ * Pass the same instance as both the receive and send serial port of BenQProjector.
+ */
+class SimulatedProjector : public HardwareSerial {
+public:
+
+	enum PowerPhase { POWER_OFF, WARMING_UP, POWER_ON, COOLING_DOWN };
+
+	struct Config {
+		const char *modelName = "W1070";
+		// my projector terminates with \r\n, the spec says \r
+		const char *lineEnding = "\r\n";
+		unsigned long echoDelayMs = 1;
+		unsigned long replyDelayMs = 20;
+		unsigned long warmUpMs = 30000;
+		unsigned long coolDownMs = 90000;
+		int lampHours = 1234;
+		int volume = 5;
+		int maxVolume = 20;
+		bool startOn = false;
+		// a key this model doesn't have, so it's answered `*Unsupported item#` (NULL for none)
+		const char *unsupportedKey = NULL;
+	};
+
+	SimulatedProjector();
+	SimulatedProjector(const Config &config);
+
+	int available() override;
+	int read() override;
+	int peek() override;
+	size_t write(uint8_t c) override;
+	using Print::write;
+
+	// called for every command frame the projector accepts, with the frame minus the * and #
+	void onCommand(std::function<void(const char *command, unsigned long at)> listener);
+
+	// simulate a noisy line by losing every nth command before the projector sees it (0 disables)
+	void setLoseEvery(int n);
+
+	// simulate noise arriving from the projector: the line is sent as-is, followed by the line ending
+	void sendNoise(const char *line);
+
+	PowerPhase getPowerPhase();
+	bool isOn();
+	const char *getSource();
+	int getVolume();
+	bool isMuted();
+	const char *getLampMode();
+	bool isImageBlanked();
+	bool isImageFrozen();
+	int getLampHours();
+
+	long getCommandCount();
+	// commands lost because the projector was busy or the line is noisy
+	long getDroppedCount();
+
+private:
+
+	Config config;
+	std::function<void(const char *, unsigned long)> commandListener;
+
+	struct Output {
+		unsigned long at;
+		std::string bytes;
+	};
+	std::deque<Output> output;
+	size_t outputIdx = 0;
+
+	std::string input;
+	unsigned long busyUntil = 0;
+	long commandCount = 0, droppedCount = 0;
+	int loseEvery = 0, sinceLost = 0;
+
+	struct {
+		PowerPhase phase = POWER_OFF;
+		unsigned long phaseSince = 0;
+		unsigned long onMillis = 0;
+		std::string source = "HDMI";
+		int volume = 0;
+		bool muted = false;
+		std::string lampMode = "LNOR";
+		bool blanked = false, frozen = false;
+	} state;
+
+	void advance();
+	void handleFrame(const std::string &frame);
+	void handleCommand(const std::string &key, const std::string &value, bool hasValue);
+	void reply(const std::string &body);
+	void setPhase(PowerPhase phase);
+	bool handleOnOff(const std::string &key, const std::string &value, bool &field);
+};
+
+#endif
@@ -2,22 +2,22 @@
 #ifdef ENABLE_HTTP
 
 #include "http.hpp"
+#include "http_response.hpp"
 #include "utils.hpp"
 #include "version.h"
 
-#include <sstream>
-
-#include <ArduinoJson.h>
-
 using namespace std;
 
 HttpSupport::HttpSupport(
-	Logger &logger, BenQProjector &projector, PowerState &projectorPower,
+	Logger &logger, BenQProjector &projector, PowerState &projectorPower, StatusCache &status,
+	LoopProfiler &profiler,
 	int httpPort,
 	bool enableOtaUpdates
-) : logger(logger), projector(projector), projectorPower(projectorPower),
+) : logger(logger), projector(projector), projectorPower(projectorPower), status(status), profiler(profiler),
 	httpServer(httpPort),
-	updateServer(true) {
+	updateServer(true),
+	events(logger, projector, projectorPower, status),
+	peakPageHeap(0) {
 
 	if (enableOtaUpdates) {
 		updateServer.setup(&httpServer, "/update");
@@ -28,138 +28,140 @@ HttpSupport::HttpSupport(
 
 void HttpSupport::setup() {
 	httpServer.on("/", HTTP_GET, [this]() {
-		stringstream response;
-
-		auto formatTime = [](long toPrint) -> function<basic_ostream<char, char_traits<char>>&(basic_ostream<char, char_traits<char>>&)> {
-			return [toPrint](basic_ostream<char, char_traits<char>> &outStream) -> ostream& {
-				float val = (millis() - toPrint) / 1000;
-				const char *unit = "seconds";
-
-				if (val > 60) {
-					val /= 60;
-					unit = val > 1 ? "minutes" : "minute";
-				}
-
-				if (val > 90) {
-					val /= 60;
-					unit = val > 1 ? "hours" : "hour";
-				}
+		if (notModified(status.getVersion(), true)) {
+			return;
+		}
 
-				return outStream << fixed << setprecision(1) << val << " " << unit;
-			};
-		};
+		ChunkedResponse response(httpServer, 200, "text/html");
 
 		auto now = millis();
 
 		auto lastPowerEvent = projector.isOn() ? projector.getLastOnTime() : projector.getLastOffTime();
 		bool powerFromPreBoot = lastPowerEvent < CONTROLLER_BOOT_THRESHOLD;
 
-		auto powerTime = now - lastPowerEvent;
+		auto powerTime = formatMillis(now - lastPowerEvent);
 
-		response
-			<< "<!DOCTYPE html>" << endl
-			<< "<html lang=\"en\">" << endl
-			<< "	<head><title>BenQ Projector Bridge</title></head>" << endl
-			<< "	<body>" << endl
-			<< "		<h1>BenQ " << projector.getModelName() << "</h1>" << endl
-			<< "		<div>Power: <span style=\"color: " << (projector.isOn() ? "green" : "red") << ";\">" << projector.getStatusStr() << "</span> (for " << (powerFromPreBoot ? "at least " : "") << formatMillis(powerTime) << "";
+		response.print(
+			"<!DOCTYPE html>\n"
+			"<html lang=\"en\">\n"
+			"	<head><title>BenQ Projector Bridge</title></head>\n"
+			"	<body>\n");
+		response.printf("		<h1>BenQ %s</h1>\n", projector.getModelName());
+		response.printf("		<div>Power: <span style=\"color: %s;\">%s</span> (for %s%.1f %s",
+			projector.isOn() ? "green" : "red", projector.getStatusStr(),
+			powerFromPreBoot ? "at least " : "", powerTime.value, powerTime.unit);
 
 		if (!projector.isOn()) {
 			// projector is off
-			auto canTurnOnAt = projectorPower.getAllowedOnTime();
-			if (canTurnOnAt > now) {
-				response << ", forced to stay off for another " << formatMillis(canTurnOnAt - now);
+			auto untilOnAllowed = projectorPower.getTimeUntilOnAllowed();
+			if (untilOnAllowed > 0) {
+				auto remaining = formatMillis(untilOnAllowed);
+				response.printf(", forced to stay off for another %.1f %s", remaining.value, remaining.unit);
 			} else {
-				response << " <form method=\"post\" action=\"/cmd/cancel-on-limit\"><input type=\"submit\" value=\"turn on\"></form>";
+				response.print(" <form method=\"post\" action=\"/cmd/cancel-on-limit\"><input type=\"submit\" value=\"turn on\"></form>");
 			}
 		} else {
 			// projector is physically on
-			auto pendingOffTime = projectorPower.getPendingRealOffTime();
+			auto untilOff = projectorPower.getTimeUntilRealOff();
 
-			if (pendingOffTime > now) {
+			if (untilOff >= 0) {
 				// we have a pending off; let's figure out why
+				auto remaining = formatMillis(untilOff);
 				if (projectorPower.getVirtualPowerState()) {
 					// projector is meant to be on, so this is a time limit
-					response << ", will power off due to time limit in " << formatMillis(pendingOffTime - now) << " <form method=\"post\" action=\"/cmd/cancel-off-limit\"><input type=\"submit\" value=\"cancel\"></form>";
+					response.printf(", will power off due to time limit in %.1f %s <form method=\"post\" action=\"/cmd/cancel-off-limit\"><input type=\"submit\" value=\"cancel\"></form>", remaining.value, remaining.unit);
 				} else {
 					// we're pretending the projector is off, so this is a requested off time
-					response << ", requested power off will happen in " << formatMillis(pendingOffTime - now) << " <form method=\"post\" action=\"/cmd/power-on\"><input type=\"submit\" value=\"cancel\"></form>";
+					response.printf(", requested power off will happen in %.1f %s <form method=\"post\" action=\"/cmd/power-on\"><input type=\"submit\" value=\"cancel\"></form>", remaining.value, remaining.unit);
 				}
 			} else {
-				response << " <form method=\"post\" action=\"/cmd/cancel-on-limit\"><input type=\"submit\" value=\"turn off\"></form>";
+				response.print(" <form method=\"post\" action=\"/cmd/cancel-on-limit\"><input type=\"submit\" value=\"turn off\"></form>");
 			}
 		}
 
-		response
-			<< ")</div>" << endl
-			<< "		<div>Lamp Hours: " << projector.getLampHours() << "</div>" << endl;
-		
+		response.print(")</div>\n");
+
+		auto transition = projector.getTransition();
+		if (transition != NULL) {
+			auto eta = projector.getTransitionEta();
+			if (eta >= 0) {
+				auto remaining = formatMillis(eta);
+				response.printf("		<div>Still %s, done in about %.1f %s</div>\n", transition, remaining.value, remaining.unit);
+			} else {
+				response.printf("		<div>Still %s</div>\n", transition);
+			}
+		}
+
+		response.printf("		<div>Lamp Hours: %d</div>\n", projector.getLampHours());
+
 		if (projector.isOn()) {
-			response
-				<< "		<div>Source: " << projector.getSource() << "</div>" << endl
-				<< "		<div>Picture: " << (projector.isImageBlanked() ? "<span style=\"color: orange;\">Blank</span>" : projector.isImageFrozen() ? "<span style=\"color: orange;\">Freeze</span>" : "Normal") << "</div>" << endl
-				<< "		<div>Volume: " << projector.getVolume() << (projector.isMuted() ? " (<span style=\"color: royalblue;\">muted</span>)" : "") << "</div>" << endl
-				<< "		<div>Lamp Mode: " << projector.getLampMode() << "</div>" << endl;
+			response.printf("		<div>Source: %s</div>\n", projector.getSource());
+			response.printf("		<div>Picture: %s</div>\n", projector.isImageBlanked() ? "<span style=\"color: orange;\">Blank</span>" : projector.isImageFrozen() ? "<span style=\"color: orange;\">Freeze</span>" : "Normal");
+			response.printf("		<div>Volume: %d%s</div>\n", projector.getVolume(), projector.isMuted() ? " (<span style=\"color: royalblue;\">muted</span>)" : "");
+			response.printf("		<div>Lamp Mode: %s</div>\n", projector.getLampMode());
 		}
 
-		response
-			// << "		<div>Last MQTT Status: <code>" << statusJson << "</code></div>" << endl
-			<< "		<div><a href=\"/log\">Log</a></div>" << endl
-			<< "	</body>" << endl
-			<< "</html>";
-		
-		httpServer.send(200, "text/html", response.str().c_str());
+		response.print(
+			"		<div><a href=\"/log\">Log</a></div>\n"
+			"	</body>\n"
+			"</html>");
+
+		pageSent(response);
 	});
 
 	httpServer.on("/status", HTTP_GET, [this]() {
-		StaticJsonDocument<128> status;
-
-		status["power"] = projector.isOn();
-		status["model"] = projector.getModelName();
-		
-		if (projector.isOn()) {
-			status["source"] = projector.getSource();
-			status["volume"] = projector.getVolume();
-			status["lamp_mode"] = projector.getLampMode();
+		if (notModified(status.getVersion())) {
+			return;
 		}
 
-		char statusJson[128];
-		serializeJson(status, statusJson, 128);
-		
-		httpServer.send(200, "application/json", statusJson);
+		httpServer.send(200, "application/json", status.getJson());
 	});
 
 	httpServer.on("/log", HTTP_GET, [this]() {
-		stringstream response;
-
-		response
-			<< "<!DOCTYPE html>" << endl
-			<< "<html lang=\"en\">" << endl
-			<< "	<head><title>BenQ Projector Bridge</title></head>" << endl
-			<< "	<body>" << endl
-			<< "		<h1>Recent Messages</h1>" << endl
-			<< "		<pre>" << endl;
-		
-		logger.foreach([&response](LogEntry entry) {
+		if (notModified(logger.getVersion())) {
+			return;
+		}
+
+		ChunkedResponse response(httpServer, 200, "text/html");
+
+		response.print(
+			"<!DOCTYPE html>\n"
+			"<html lang=\"en\">\n"
+			"	<head><title>BenQ Projector Bridge</title></head>\n"
+			"	<body>\n"
+			"		<h1>Recent Messages</h1>\n"
+			"		<pre>\n");
+
+		logger.foreach([&response](const LogEntry &entry) {
 			switch (entry.type) {
-				case DEBUG_LOG: response << "DEBUG "; break;
-				case INFO_LOG:  response << "INFO  "; break;
-				case ERROR_LOG: response << "ERROR "; break;
-				case COMM_SENT: response << "  &gt;&gt;  "; break;
-				case COMM_ECHO: response << "  &lt;&gt;  "; break;
-				case COMM_RECV: response << "  &lt;&lt;  "; break;
+				case DEBUG_LOG: response.print("DEBUG "); break;
+				case INFO_LOG:  response.print("INFO  "); break;
+				case ERROR_LOG: response.print("ERROR "); break;
+				case COMM_SENT: response.print("  &gt;&gt;  "); break;
+				case COMM_ECHO: response.print("  &lt;&gt;  "); break;
+				case COMM_RECV: response.print("  &lt;&lt;  "); break;
 			}
 
-			response << entry.entry << endl;
+			char line[LOG_LINE_SIZE];
+			entry.format(line, sizeof(line));
+			response.print(line);
+			response.print("\n");
 		});
 
-		response
-			<< "		</pre>" << endl
-			<< "		<form method=\"post\" action=\"/send\"><input type=\"text\" name=\"cmd\"><input type=\"submit\" value=\"Send\"></form>" << endl
-			<< "	</body>" << endl
-			<< "</html>";
-		
-		httpServer.send(200, "text/html", response.str().c_str());
+		response.print(
+			"		</pre>\n"
+			"		<form method=\"post\" action=\"/send\"><input type=\"text\" name=\"cmd\"><input type=\"submit\" value=\"Send\"></form>\n"
+			"	</body>\n"
+			"</html>");
+
+		pageSent(response);
+	});
+
+	httpServer.on("/events", HTTP_GET, [this]() {
+		// the connection is kept for the events, which are written to it from then on
+		if (!events.subscribe(httpServer.client())) {
+			httpServer.send(503, "text/plain", "Too many clients listening to /events");
+		}
 	});
 
 	httpServer.on("/send", HTTP_POST, [this]() {
@@ -200,50 +202,180 @@ void HttpSupport::setup() {
 	});
 
 	httpServer.on("/about", HTTP_GET, [this]() {
-		stringstream about;
-		about << "BenQ Bridge version " << VERSION << "; copyright (C) 2020 Robert Ferris";
-
-		httpServer.send(200, "text/plain", about.str().c_str());
+		httpServer.send(200, "text/plain", "BenQ Bridge version " VERSION "; copyright (C) 2020 Robert Ferris");
 	});
 
 	httpServer.on("/stats", HTTP_GET, [this]() {
-		stringstream response;
-
-		long total;
+		long total, received;
 		int count10s, count60s, count360s;
 		float rate10s, rate60s, rate360s;
 
-		response
-			<< "<!DOCTYPE html>" << endl
-			<< "<html lang=\"en\">" << endl
-			<< "	<head><title>BenQ Projector Bridge</title></head>" << endl
-			<< "	<body>" << endl
-			<< "		<h1>Nerd Stats</h1>" << endl
-			<< "		<div>Uptime: " << formatMillis(millis()) << "</div>" << endl;
-		
+		// everything else on the page moves with the traffic or with time
+		projector.getSendStats(total, count10s, count60s, count360s, rate10s, rate60s, rate360s);
+		projector.getRecvStats(received, count10s, count60s, count360s, rate10s, rate60s, rate360s);
+		if (notModified(total + received, true)) {
+			return;
+		}
+
+		ChunkedResponse response(httpServer, 200, "text/html");
+
+		auto uptime = formatMillis(millis());
+		response.print(
+			"<!DOCTYPE html>\n"
+			"<html lang=\"en\">\n"
+			"	<head><title>BenQ Projector Bridge</title></head>\n"
+			"	<body>\n"
+			"		<h1>Nerd Stats</h1>\n");
+		response.printf("		<div>Uptime: %.1f %s</div>\n", uptime.value, uptime.unit);
+
 		projector.getSendStats(total, count10s, count60s, count360s, rate10s, rate60s, rate360s);
-		response
-			<< "		<h2>Messages Sent</h2>" << endl
-			<< "		<div>Total: " << total << "</div>" << endl
-			<< "		<div>10s: " << count10s << ", 1m: " << count60s << ", 10m: " << count360s << "</div>" << endl
-			<< fixed << setprecision(2)
-			<< "		<div>Rate: " << rate10s << "/s (10s), " << rate60s << "/s (1m), " << rate360s << "/s (10m)</div>" << endl;
+		response.print("		<h2>Messages Sent</h2>\n");
+		response.printf("		<div>Total: %ld</div>\n", total);
+		response.printf("		<div>10s: %d, 1m: %d, 6m: %d</div>\n", count10s, count60s, count360s);
+		response.printf("		<div>Rate: %.2f/s (10s), %.2f/s (1m), %.2f/s (6m)</div>\n", rate10s, rate60s, rate360s);
 
 		projector.getRecvStats(total, count10s, count60s, count360s, rate10s, rate60s, rate360s);
-		response
-			<< "		<h2>Messages Received</h2>" << endl
-			<< "		<div>Total: " << total << "</div>" << endl
-			<< "		<div>10s: " << count10s << ", 1m: " << count60s << ", 10m: " << count360s << "</div>" << endl
-			<< fixed << setprecision(2)
-			<< "		<div>Rate: " << rate10s << "/s (10s), " << rate60s << "/s (1m), " << rate360s << "/s (10m)</div>" << endl;
-		
-		response
-			<< "	</body>" << endl
-			<< "</html>";
-		
-		httpServer.send(200, "text/html", response.str().c_str());
+		response.print("		<h2>Messages Received</h2>\n");
+		response.printf("		<div>Total: %ld</div>\n", total);
+		response.printf("		<div>10s: %d, 1m: %d, 6m: %d</div>\n", count10s, count60s, count360s);
+		response.printf("		<div>Rate: %.2f/s (10s), %.2f/s (1m), %.2f/s (6m)</div>\n", rate10s, rate60s, rate360s);
+
+		float framesPerLoop;
+		int maxFramesPerLoop;
+		long budgetOverruns;
+		projector.getRecvLoopStats(framesPerLoop, maxFramesPerLoop, budgetOverruns);
+		response.printf("		<div>Per loop: %.1f average, %d max (budget ran out %ld times)</div>\n", framesPerLoop, maxFramesPerLoop, budgetOverruns);
+
+		long duplicateQueries, replacedSetters;
+		projector.getCoalesceStats(duplicateQueries, replacedSetters);
+		response.print("		<h2>Send Queue</h2>\n");
+		response.printf("		<div>Pending: %d interactive, %d state, %d polling</div>\n",
+			projector.getQueueDepth(PRIORITY_INTERACTIVE), projector.getQueueDepth(PRIORITY_STATE), projector.getQueueDepth(PRIORITY_POLL));
+		response.printf("		<div>Duplicate queries dropped: %ld</div>\n", duplicateQueries);
+		response.printf("		<div>Superseded setters replaced: %ld</div>\n", replacedSetters);
+
+		float responseTime;
+		int timeout, gap;
+		long timeouts;
+		projector.getPacingStats(responseTime, timeout, gap, timeouts);
+		response.print("		<h2>Send Pacing</h2>\n");
+		response.printf("		<div>Response time: %.1fms (timeout %dms)</div>\n", responseTime, timeout);
+		response.printf("		<div>Gap after response: %dms</div>\n", gap);
+		response.printf("		<div>Timeouts: %ld</div>\n", timeouts);
+
+		long retries, failures;
+		projector.getCommandStats(retries, failures);
+		response.printf("		<div>Retries: %ld, failed commands: %ld</div>\n", retries, failures);
+
+		long warmUpMs, coolDownMs;
+		int warmUpsSeen, coolDownsSeen;
+		projector.getLearnedTransitions(warmUpMs, warmUpsSeen, coolDownMs, coolDownsSeen);
+		response.print("		<h2>Power Transitions</h2>\n");
+		if (warmUpMs >= 0) {
+			response.printf("		<div>Warm-up: %.1fs (seen %d times)</div>\n", warmUpMs / 1000.0f, warmUpsSeen);
+		} else {
+			response.print("		<div>Warm-up: not seen yet</div>\n");
+		}
+		if (coolDownMs >= 0) {
+			response.printf("		<div>Cool-down: %.1fs (seen %d times)</div>\n", coolDownMs / 1000.0f, coolDownsSeen);
+		} else {
+			response.print("		<div>Cool-down: not seen yet</div>\n");
+		}
+
+		response.print("		<h2>Loop Time</h2>\n");
+		response.printf("		<div>Over the last %d-%ds, in &micro;s (over budget is since boot, with a budget of %dms)</div>\n",
+			LOOP_PROFILER_WINDOW / 1000, 2 * LOOP_PROFILER_WINDOW / 1000, LOOP_PROFILER_BUDGET / 1000);
+		response.print(
+			"		<table>\n"
+			"			<tr><th></th><th>min</th><th>avg</th><th>p99</th><th>max</th><th>over budget</th></tr>\n");
+		LoopProfiler::Timing timing;
+		for (int i = 0; profiler.getTiming(i, timing); ++i) {
+			response.printf("			<tr><td>%s</td><td>%lu</td><td>%lu</td><td>%lu</td><td>%lu</td><td>%ld</td></tr>\n",
+				timing.name, timing.min, timing.average, timing.p99, timing.max, timing.overBudget);
+		}
+		response.print("		</table>\n");
+
+		response.print("		<h2>HTTP</h2>\n");
+		response.printf("		<div>Peak heap used sending a page: %u bytes</div>\n", (unsigned)peakPageHeap);
+		response.printf("		<div>Listening to /events: %d (%ld dropped for falling behind)</div>\n", events.getSubscriberCount(), events.getDroppedCount());
+
+		response.print(
+			"	</body>\n"
+			"</html>");
+
+		pageSent(response);
+	});
+
+	httpServer.on("/metrics", HTTP_GET, [this]() {
+		ChunkedResponse response(httpServer, 200, "text/plain; version=0.0.4");
+		MetricsWriter metrics(response);
+
+		long total, received;
+		int count10s, count60s, count360s;
+		float rate10s, rate60s, rate360s;
+		projector.getSendStats(total, count10s, count60s, count360s, rate10s, rate60s, rate360s);
+		projector.getRecvStats(received, count10s, count60s, count360s, rate10s, rate60s, rate360s);
+		metrics.counter("benq_messages_sent_total", "Messages sent to the projector.", total);
+		metrics.counter("benq_messages_received_total", "Messages received from the projector.", received);
+
+		metrics.family("benq_send_queue_depth", "gauge", "Commands waiting to be sent, by priority.");
+		metrics.sample("benq_send_queue_depth", "priority", "interactive", projector.getQueueDepth(PRIORITY_INTERACTIVE));
+		metrics.sample("benq_send_queue_depth", "priority", "state", projector.getQueueDepth(PRIORITY_STATE));
+		metrics.sample("benq_send_queue_depth", "priority", "poll", projector.getQueueDepth(PRIORITY_POLL));
+
+		metrics.histogram("benq_response_latency_milliseconds", "Time from sending a command to the projector's answer.", projector.getResponseLatency());
+
+		metrics.family("benq_value_age_seconds", "gauge", "Time since each value was last received from the projector.");
+		const char *key;
+		long ageMs;
+		for (size_t i = 0; projector.getValueAge(i, key, ageMs); ++i) {
+			metrics.sample("benq_value_age_seconds", "key", key, ageMs / 1000.0);
+		}
+
+		long malformed, overflowed;
+		projector.getFrameErrorStats(malformed, overflowed);
+		metrics.counter("benq_parse_errors_total", "Lines from the projector that couldn't be read as a message.", malformed + overflowed);
+
+		long illegalFormat, blocked, unsupported;
+		projector.getErrorReplyStats(illegalFormat, blocked, unsupported);
+		metrics.family("benq_error_replies_total", "counter", "Commands the projector refused, by reason.");
+		metrics.sample("benq_error_replies_total", "reason", "illegal_format", illegalFormat);
+		metrics.sample("benq_error_replies_total", "reason", "blocked", blocked);
+		metrics.sample("benq_error_replies_total", "reason", "unsupported", unsupported);
+
+		float responseTime;
+		int timeout, gap;
+		long timeouts;
+		projector.getPacingStats(responseTime, timeout, gap, timeouts);
+		long retries, failures;
+		projector.getCommandStats(retries, failures);
+		metrics.counter("benq_timeouts_total", "Commands the projector didn't answer in time.", timeouts);
+		metrics.counter("benq_retries_total", "Commands sent again after a timeout.", retries);
+		metrics.counter("benq_failed_commands_total", "Commands given up on after running out of retries.", failures);
+
+		float framesPerLoop;
+		int maxFramesPerLoop;
+		long budgetOverruns;
+		projector.getRecvLoopStats(framesPerLoop, maxFramesPerLoop, budgetOverruns);
+		metrics.counter("benq_receive_budget_overruns_total", "Loops that left received messages for the next one.", budgetOverruns);
+
+		metrics.gauge("benq_free_heap_bytes", "Free heap.", ESP.getFreeHeap());
+		metrics.gauge("benq_max_free_block_bytes", "Largest block that could be allocated.", ESP.getMaxFreeBlockSize());
+		metrics.gauge("benq_heap_fragmentation_percent", "Heap fragmentation.", ESP.getHeapFragmentation());
+		metrics.gauge("benq_uptime_seconds", "Time since the bridge started.", millis() / 1000.0);
+		metrics.counter("benq_events_dropped_total", "/events clients dropped for falling behind.", events.getDroppedCount());
+
+		for (auto &writeMetrics : extraMetrics) {
+			writeMetrics(metrics);
+		}
+
+		pageSent(response);
 	});
 
+	// ESP8266WebServer throws away any request header it wasn't asked to keep
+	static const char *headers[] = { "If-None-Match" };
+	httpServer.collectHeaders(headers, sizeof(headers) / sizeof(headers[0]));
+
 	httpServer.begin();
 }
 
@@ -261,8 +393,42 @@ void HttpSupport::addHomeKitSupport(function<string(string)> getStatusPageHtml,
 	});
 }
 
+void HttpSupport::addMetrics(function<void(MetricsWriter &)> writeMetrics) {
+	extraMetrics.push_back(writeMetrics);
+}
+
+void HttpSupport::pageSent(ChunkedResponse &response) {
+	response.end();
+
+	if (response.getPeakHeapUse() > peakPageHeap) {
+		peakPageHeap = response.getPeakHeapUse();
+	}
+}
+
+bool HttpSupport::notModified(unsigned long version, bool timed) {
+	char etag[24];
+	if (timed) {
+		snprintf(etag, sizeof(etag), "\"%lx-%lx\"", version, (unsigned long)(millis() / HTTP_ETAG_PERIOD));
+	} else {
+		snprintf(etag, sizeof(etag), "\"%lx\"", version);
+	}
+
+	httpServer.sendHeader("ETag", etag);
+	// caches have to check back every time, which is what makes the 304s worth having
+	httpServer.sendHeader("Cache-Control", "no-cache");
+
+	String ifNoneMatch = httpServer.header("If-None-Match");
+	if (ifNoneMatch.length() == 0 || (ifNoneMatch != "*" && strstr(ifNoneMatch.c_str(), etag) == NULL)) {
+		return false;
+	}
+
+	httpServer.send(304);
+	return true;
+}
+
 void HttpSupport::loop() {
 	httpServer.handleClient();
+	events.loop();
 }
 
 #endif
\ No newline at end of file
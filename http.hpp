@@ -5,11 +5,21 @@
 // say "at least" in the UI
 #define CONTROLLER_BOOT_THRESHOLD 30000
 
+// pages that show how long ago something happened get a new ETag every 10 seconds, so a cached
+// copy can be at most this far behind
+#define HTTP_ETAG_PERIOD 10000
+
+#include "event_stream.hpp"
+#include "http_response.hpp"
 #include "logger.hpp"
+#include "loop_profiler.hpp"
+#include "metrics_writer.hpp"
 #include "projector.hpp"
 #include "power_state.hpp"
+#include "status_cache.hpp"
 
 #include <functional>
+#include <list>
 #include <string>
 
 #include <ESP8266WebServer.h>
@@ -25,7 +35,8 @@ class HttpSupport {
 public:
 
 	HttpSupport(
-		Logger &logger, BenQProjector &projector, PowerState &projectorPower,
+		Logger &logger, BenQProjector &projector, PowerState &projectorPower, StatusCache &status,
+		LoopProfiler &profiler,
 		int httpPort,
 		bool enableOtaUpdates
 	);
@@ -35,13 +46,29 @@ public:
 
 	void addHomeKitSupport(function<string(string)> getStatusPageHtml, function<void()> resetHomeKit);
 
+	// more for /metrics to show, from things HTTP doesn't otherwise know about
+	void addMetrics(function<void(MetricsWriter &)> writeMetrics);
+
 private:
 
 	Logger &logger;
 	BenQProjector &projector;
 	PowerState &projectorPower;
+	StatusCache &status;
+	LoopProfiler &profiler;
 	ESP8266WebServer httpServer;
 	ESP8266HTTPUpdateServer updateServer;
+	EventStream events;
+	std::list<function<void(MetricsWriter &)>> extraMetrics;
+
+	// the most heap any page has needed while it was being sent
+	uint32_t peakPageHeap;
+
+	void pageSent(ChunkedResponse &response);
+
+	// tags the response with an ETag for this version of the content; if that's what the client
+	// already has, answers 304 and returns true, and the handler has nothing left to do
+	bool notModified(unsigned long version, bool timed = false);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include "config.h"
+#ifdef ENABLE_HTTP
+
+#include "http_response.hpp"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+ChunkedResponse::ChunkedResponse(ESP8266WebServer &server, int code, const char *contentType) :
+	server(server), len(0), sent(0) {
+
+	startHeap = lowestHeap = ESP.getFreeHeap();
+
+	// headers go out now; the body follows as chunks
+	server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+	server.send(code, contentType, "");
+}
+
+void ChunkedResponse::print(const char *text) {
+	size_t textLen = strlen(text);
+
+	while (textLen > 0) {
+		if (len == HTTP_CHUNK_SIZE) {
+			flush();
+		}
+
+		size_t part = textLen < HTTP_CHUNK_SIZE - len ? textLen : HTTP_CHUNK_SIZE - len;
+		memcpy(buffer + len, text, part);
+		len += part;
+		text += part;
+		textLen -= part;
+	}
+}
+
+void ChunkedResponse::printf(const char *format, ...) {
+	va_list args, retry;
+	va_start(args, format);
+	va_copy(retry, args);
+
+	// format straight into the buffer; if it doesn't fit in what's left, send what's there and
+	// format it again into the empty buffer
+	int written = vsnprintf(buffer + len, HTTP_CHUNK_SIZE - len, format, args);
+	if (written >= 0 && (size_t)written >= HTTP_CHUNK_SIZE - len) {
+		flush();
+		written = vsnprintf(buffer, HTTP_CHUNK_SIZE, format, retry);
+	}
+
+	if (written > 0) {
+		len += (size_t)written < HTTP_CHUNK_SIZE - len ? written : HTTP_CHUNK_SIZE - len - 1;
+	}
+
+	va_end(retry);
+	va_end(args);
+}
+
+void ChunkedResponse::flush() {
+	if (len == 0) {
+		return;
+	}
+
+	server.sendContent(buffer, len);
+	sent += len;
+	len = 0;
+
+	uint32_t heap = ESP.getFreeHeap();
+	if (heap < lowestHeap) {
+		lowestHeap = heap;
+	}
+}
+
+void ChunkedResponse::end() {
+	flush();
+
+	// an empty chunk ends the response
+	server.sendContent("");
+}
+
+size_t ChunkedResponse::getBytesSent() {
+	return sent;
+}
+
+uint32_t ChunkedResponse::getPeakHeapUse() {
+	return startHeap - lowestHeap;
+}
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef HTTP_RESPONSE_HPP
+#define HTTP_RESPONSE_HPP
+
+// default chunk buffer of 256 bytes; this is all a page needs while it's being sent
+#define HTTP_CHUNK_SIZE 256
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <ESP8266WebServer.h>
+
+/**
+ * Streams a page to the client with chunked transfer encoding, a buffer's worth at a time, so a
+ * page never has to exist in memory all at once. Write everything with print()/printf(), then
+ * call end().
+ *
+ * While the page is going out, the free heap is checked on every chunk; getPeakHeapUse() is how
+ * far it dropped below where it was when the response started.
+ */
+class ChunkedResponse {
+public:
+
+	ChunkedResponse(ESP8266WebServer &server, int code, const char *contentType);
+
+	void print(const char *text);
+	// a single printf can't produce more than HTTP_CHUNK_SIZE bytes; anything beyond is cut off
+	void printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+	void end();
+
+	size_t getBytesSent();
+	uint32_t getPeakHeapUse();
+
+private:
+
+	ESP8266WebServer &server;
+	char buffer[HTTP_CHUNK_SIZE];
+	size_t len;
+	size_t sent;
+
+	uint32_t startHeap;
+	uint32_t lowestHeap;
+
+	void flush();
+};
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef KEY_TABLE_HPP
+#define KEY_TABLE_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+/**
+ * Case-insensitive lookup table from protocol keys to entries, built at compile time around a
+ * perfect hash: the constructor searches for a hash seed under which no two keys land in the same
+ * slot, so a lookup is one hash, one slot read and one string compare (to reject keys that aren't
+ * in the table) no matter how many keys there are.
+ *
+ * Entries can be any type with a `const char *key` member. Declare the entries and the table
+ * `static constexpr` so all of this happens in the compiler (duplicate keys never get a seed, so
+ * they fail to compile once the compiler's constexpr loop limit is hit):
+ *
+ *   static constexpr Entry entries[] = { { "pow", ... }, { "sour", ... } };
+ *   static constexpr KeyTable<Entry, 2> table(entries);
+ */
+template<typename Entry, size_t N> class KeyTable {
+public:
+
+	// twice as many slots as keys (rounded up to a power of two) makes a perfect seed easy to find
+	static constexpr size_t SIZE = N <= 1 ? 2 : (size_t)1 << (64 - __builtin_clzll((N * 2) - 1));
+
+	constexpr KeyTable(const Entry (&entries)[N]) : entries(entries), seed(0), slots() {
+		static_assert(N < 128, "KeyTable supports up to 127 entries");
+
+		while (!tryBuild()) {
+			seed++;
+		}
+	}
+
+	const Entry *find(const char *key, size_t len) const {
+		int idx = slots[hash(key, len, seed) & (SIZE - 1)];
+
+		if (idx < 0 || strncasecmp(entries[idx].key, key, len) != 0 || entries[idx].key[len] != 0) {
+			return NULL;
+		}
+
+		return &entries[idx];
+	}
+
+	const Entry *find(const char *key) const {
+		return find(key, strlen(key));
+	}
+
+	static constexpr uint32_t hash(const char *key, size_t len, uint32_t seed) {
+		// FNV-1a over the lower-cased key, then a final mix so that different seeds spread out
+		uint32_t h = 2166136261u ^ (seed * 0x9E3779B1u);
+
+		for (size_t i = 0; i < len; ++i) {
+			char c = key[i];
+			h ^= (uint8_t)(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+			h *= 16777619u;
+		}
+
+		h ^= h >> 13;
+		h *= 0x5BD1E995u;
+		h ^= h >> 15;
+		return h;
+	}
+
+private:
+
+	const Entry (&entries)[N];
+	uint32_t seed;
+	int8_t slots[SIZE];
+
+	static constexpr size_t length(const char *key) {
+		size_t len = 0;
+		while (key[len] != 0) {
+			len++;
+		}
+		return len;
+	}
+
+	constexpr bool tryBuild() {
+		for (size_t i = 0; i < SIZE; ++i) {
+			slots[i] = -1;
+		}
+
+		for (size_t i = 0; i < N; ++i) {
+			size_t slot = hash(entries[i].key, length(entries[i].key), seed) & (SIZE - 1);
+
+			if (slots[slot] >= 0) {
+				return false;
+			}
+
+			slots[slot] = i;
+		}
+
+		return true;
+	}
+};
+
+#endif
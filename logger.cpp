@@ -1,39 +1,247 @@
 #include "logger.hpp"
 
-LogEntry::LogEntry(LogEntryType type, std::string entry) :
-	type(type), entry(entry) {
+#include <stdio.h>
+
+// each entry starts with its total size, its type and its format string
+#define LOG_HEADER_SIZE (sizeof(uint16_t) + sizeof(uint8_t) + sizeof(const char *))
+
+Logger::Logger() : start(0), end(0), wrapAt(LOG_ARENA_SIZE), count(0), last(0), version(0) {
 }
 
-void Logger::addListener(std::function<void(LogEntry)> listener) {
+void Logger::addListener(std::function<void(const LogEntry &)> listener) {
 	listeners.push_back(listener);
 }
 
-void Logger::log(LogEntryType type, std::string entry) {
-	LogEntry logEntry(type, entry);
+uint8_t *Logger::append(LogEntryType type, const char *format, size_t argsLen) {
+	uint16_t size = LOG_HEADER_SIZE + argsLen;
+
+	// make room after end, throwing out the oldest entries and wrapping around as needed
+	for (;;) {
+		if (count == 0) {
+			start = end = 0;
+			wrapAt = LOG_ARENA_SIZE;
+		}
+
+		bool wrapped = count > 0 && start >= end;
+		size_t limit = wrapped ? start : LOG_ARENA_SIZE;
+
+		if (end + size <= limit) {
+			break;
+		}
+
+		if (wrapped) {
+			evictOldest();
+		} else {
+			// no room left before the end of the arena; the space after end goes unused
+			wrapAt = end;
+			end = 0;
+		}
+	}
+
+	uint8_t *out = arena + end;
+	uint8_t typeByte = type;
+	memcpy(out, &size, sizeof(size));
+	memcpy(out + sizeof(size), &typeByte, sizeof(typeByte));
+	memcpy(out + sizeof(size) + sizeof(typeByte), &format, sizeof(format));
+
+	last = end;
+	end += size;
+	count++;
+	version++;
+
+	return out + LOG_HEADER_SIZE;
+}
+
+void Logger::evictOldest() {
+	uint16_t size;
+	memcpy(&size, arena + start, sizeof(size));
+
+	start += size;
+	count--;
+
+	if (count == 0) {
+		start = end = 0;
+		wrapAt = LOG_ARENA_SIZE;
+	} else if (start >= wrapAt) {
+		start = 0;
+		wrapAt = LOG_ARENA_SIZE;
+	}
+}
+
+LogEntry Logger::entryAt(size_t offset) {
+	uint16_t size;
+	uint8_t typeByte;
+	LogEntry entry;
+
+	const uint8_t *in = arena + offset;
+	memcpy(&size, in, sizeof(size));
+	memcpy(&typeByte, in + sizeof(size), sizeof(typeByte));
+	memcpy(&entry.formatString, in + sizeof(size) + sizeof(typeByte), sizeof(entry.formatString));
+
+	entry.type = (LogEntryType)typeByte;
+	entry.args = in + LOG_HEADER_SIZE;
+	entry.argsLen = size - LOG_HEADER_SIZE;
+	return entry;
+}
 
-	entries.push_back(logEntry);
-	trimLog();
+void Logger::notify() {
+	if (listeners.empty()) {
+		return;
+	}
 
+	LogEntry entry = entryAt(last);
 	for (auto it = listeners.begin(); it != listeners.end(); it++) {
-		(*it)(logEntry);
+		(*it)(entry);
 	}
 }
 
-void Logger::trimLog() {
-	while (entries.size() > LOG_ENTRIES) {
-		entries.pop_front();
+void Logger::foreach(std::function<void(const LogEntry &)> f) {
+	size_t offset = start;
+	for (size_t i = 0; i < count; ++i) {
+		LogEntry entry = entryAt(offset);
+		f(entry);
+
+		offset += LOG_HEADER_SIZE + entry.argsLen;
+		if (offset >= wrapAt) {
+			offset = 0;
+		}
 	}
 }
 
-void Logger::debug(std::string entry) { log(DEBUG_LOG, entry); }
-void Logger::info(std::string entry) { log(INFO_LOG, entry); }
-void Logger::error(std::string entry) { log(ERROR_LOG, entry); }
-void Logger::commSent(std::string entry) { log(COMM_SENT, entry); }
-void Logger::commEcho(std::string entry) { log(COMM_ECHO, entry); }
-void Logger::commRecv(std::string entry) { log(COMM_RECV, entry); }
+unsigned long Logger::getVersion() {
+	return version;
+}
 
-void Logger::foreach(std::function<void(LogEntry)> f) {
-	for (auto it = entries.begin(); it != entries.end(); it++) {
-		f(*it);
+size_t LogEntry::format(char *buffer, size_t size) const {
+	if (size == 0) {
+		return 0;
 	}
+
+	const uint8_t *in = args, *inEnd = args + argsLen;
+	size_t len = 0;
+
+	uint8_t type;
+	uint64_t number;
+	const char *string;
+	size_t stringLen;
+
+	// reads back the next argument written by Logger::putArg; false once they've run out
+	auto nextArg = [&]() {
+		if (in >= inEnd) {
+			return false;
+		}
+
+		type = *in++;
+		if (type == Logger::ARG_STRING) {
+			stringLen = *in++;
+			string = (const char *)in;
+			in += stringLen;
+		} else {
+			memcpy(&number, in, sizeof(number));
+			in += sizeof(number);
+		}
+		return true;
+	};
+
+	// everything printed goes through here, so it can never run past the buffer
+	auto printed = [&](int n) {
+		if (n > 0) {
+			len += (size_t)n < size - len ? n : size - len - 1;
+		}
+	};
+
+	for (const char *f = formatString; *f != 0 && len + 1 < size; ++f) {
+		if (*f != '%') {
+			buffer[len++] = *f;
+			continue;
+		}
+		if (f[1] == '%') {
+			buffer[len++] = '%';
+			f++;
+			continue;
+		}
+
+		// rebuild the conversion with the flags and width as they are, but the length modifier
+		// swapped for the one matching how the argument was stored
+		char spec[32] = "%";
+		size_t specLen = 1;
+		int precision = -1;
+		const char *p = f + 1;
+
+		while (*p != 0 && strchr("-+ #0", *p) != NULL && specLen < 8) {
+			spec[specLen++] = *p++;
+		}
+		if (*p == '*') {
+			p++;
+			int width = nextArg() && type != Logger::ARG_STRING ? (int)number : 0;
+			specLen += snprintf(spec + specLen, 12, "%d", width);
+		} else {
+			while (*p >= '0' && *p <= '9' && specLen < 16) {
+				spec[specLen++] = *p++;
+			}
+		}
+		if (*p == '.') {
+			p++;
+			precision = 0;
+			if (*p == '*') {
+				p++;
+				precision = nextArg() && type != Logger::ARG_STRING ? (int)number : 0;
+			} else {
+				for (; *p >= '0' && *p <= '9'; ++p) {
+					precision = precision * 10 + (*p - '0');
+				}
+			}
+		}
+		while (*p != 0 && strchr("hljztL", *p) != NULL) {
+			p++;
+		}
+
+		char conversion = *p;
+		if (conversion == 0) {
+			break;
+		}
+		f = p;
+
+		if (!nextArg()) {
+			// more conversions than arguments
+			buffer[len++] = '?';
+			continue;
+		}
+
+		if (type == Logger::ARG_STRING) {
+			if (precision >= 0 && (size_t)precision < stringLen) {
+				stringLen = precision;
+			}
+			strcpy(spec + specLen, ".*s");
+			printed(snprintf(buffer + len, size - len, spec, (int)stringLen, string));
+			continue;
+		}
+
+		if (precision >= 0) {
+			specLen += snprintf(spec + specLen, 12, ".%d", precision);
+		}
+
+		if (type == Logger::ARG_DOUBLE) {
+			double value;
+			memcpy(&value, &number, sizeof(value));
+			spec[specLen++] = strchr("fFeEgGaA", conversion) != NULL ? conversion : 'g';
+			spec[specLen] = 0;
+			printed(snprintf(buffer + len, size - len, spec, value));
+		} else if (conversion == 'c') {
+			strcpy(spec + specLen, "c");
+			printed(snprintf(buffer + len, size - len, spec, (int)number));
+		} else if (strchr("ouxX", conversion) != NULL) {
+			spec[specLen++] = 'l';
+			spec[specLen++] = 'l';
+			spec[specLen++] = conversion;
+			spec[specLen] = 0;
+			printed(snprintf(buffer + len, size - len, spec, (unsigned long long)number));
+		} else {
+			strcpy(spec + specLen, type == Logger::ARG_UINT ? "llu" : "lld");
+			printed(snprintf(buffer + len, size - len, spec, (long long)number));
+		}
+	}
+
+	buffer[len] = 0;
+	return len;
 }
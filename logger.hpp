@@ -1,13 +1,27 @@
 #ifndef LOG_HPP
 #define LOG_HPP
 
-// default number of log entries to keep is 32, messages beyond this get purged
-#define LOG_ENTRIES 32
+// default log arena of 2KB; once it's full, the oldest entries get purged to make room
+#define LOG_ARENA_SIZE 2048
+
+// longest a single string argument can be in an entry; anything past this is cut off
+#define LOG_MAX_STRING 96
+
+// buffer size for formatting a single entry; longer entries get cut off
+#define LOG_LINE_SIZE 160
+
+// default to keeping everything; set to INFO_LOG or ERROR_LOG before including this to compile
+// out the levels below it (projector traffic counts as debug)
+#ifndef LOG_LEVEL
+#define LOG_LEVEL DEBUG_LOG
+#endif
 
-#include <deque>
 #include <functional>
 #include <list>
-#include <string>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
 
 enum LogEntryType {
 	// various remark levels
@@ -17,39 +31,142 @@ enum LogEntryType {
 	COMM_SENT, COMM_ECHO, COMM_RECV,
 };
 
+/**
+ * An entry as it sits in the log: the format string it was logged with, plus a copy of the
+ * arguments. It isn't formatted until somebody asks for it with format(), and it points into the
+ * log's arena, so it's only valid until the next entry is logged.
+ */
 struct LogEntry {
-	LogEntry(LogEntryType type, std::string entry);
-
 	LogEntryType type;
-	std::string entry;
+	const char *formatString;
+	const uint8_t *args;
+	size_t argsLen;
+
+	// printf-style; writes as much as fits (always null-terminated) and returns what it wrote
+	size_t format(char *buffer, size_t size) const;
 };
 
 /**
- * Logger that manages a rotating log of the last `LOG_ENTRIES` entries. This is available for
- * display (e.g., on a web UI), can optionally be logged to a Serial debugging console, and can
- * also be subscribed to externally (e.g., to send over MQTT)
+ * Logger that keeps a rotating log of recent entries in a fixed `LOG_ARENA_SIZE` byte arena. This
+ * is available for display (e.g., on a web UI), can optionally be logged to a Serial debugging
+ * console, and can also be subscribed to externally (e.g., to send over MQTT)
+ *
+ * Logging is printf-style, but nothing is formatted at log time: the arguments are copied into the
+ * arena as they are (strings by value, since most of ours live in buffers that get reused) and the
+ * format string is kept by pointer, so it has to be a literal. Logging an entry never touches the
+ * heap, which matters for the projector traffic that gets logged several times a second.
  */
 class Logger {
 public:
 
-	void addListener(std::function<void(LogEntry)> listener);
+	Logger();
+
+	void addListener(std::function<void(const LogEntry &)> listener);
+
+	template<typename... Args> void log(LogEntryType type, const char *format, Args... args) {
+		size_t argsLen = 0;
+		((argsLen += argSize(args)), ...);
+
+		uint8_t *out = append(type, format, argsLen);
+		((out = putArg(out, args)), ...);
+		(void)out;
 
-	void log(LogEntryType type, std::string entry);
-	void debug(std::string entry);
-	void info(std::string entry);
-	void error(std::string entry);
-	void commSent(std::string entry);
-	void commEcho(std::string entry);
-	void commRecv(std::string entry);
+		notify();
+	}
 
-	void foreach(std::function<void(LogEntry)> f);
+	template<typename... Args> void debug(const char *format, Args... args) {
+		if (LOG_LEVEL <= DEBUG_LOG) log(DEBUG_LOG, format, args...);
+	}
+	template<typename... Args> void info(const char *format, Args... args) {
+		if (LOG_LEVEL <= INFO_LOG) log(INFO_LOG, format, args...);
+	}
+	template<typename... Args> void error(const char *format, Args... args) {
+		if (LOG_LEVEL <= ERROR_LOG) log(ERROR_LOG, format, args...);
+	}
+	template<typename... Args> void commSent(const char *format, Args... args) {
+		if (LOG_LEVEL <= DEBUG_LOG) log(COMM_SENT, format, args...);
+	}
+	template<typename... Args> void commEcho(const char *format, Args... args) {
+		if (LOG_LEVEL <= DEBUG_LOG) log(COMM_ECHO, format, args...);
+	}
+	template<typename... Args> void commRecv(const char *format, Args... args) {
+		if (LOG_LEVEL <= DEBUG_LOG) log(COMM_RECV, format, args...);
+	}
+
+	void foreach(std::function<void(const LogEntry &)> f);
+
+	// goes up with every entry logged
+	unsigned long getVersion();
 
 private:
 
-	std::list<std::function<void(LogEntry)>> listeners;
-	std::deque<LogEntry> entries;
+	// how each argument is tagged in the arena; integers and floats are widened so that formatting
+	// doesn't have to care which type they were logged as
+	enum ArgType : uint8_t {ARG_INT, ARG_UINT, ARG_DOUBLE, ARG_STRING};
+
+	std::list<std::function<void(const LogEntry &)>> listeners;
+
+	uint8_t arena[LOG_ARENA_SIZE];
+	// entries run from start, up to wrapAt if they've wrapped around, and on from 0 to end
+	size_t start, end, wrapAt, count;
+	// the entry being written, until it's been passed to the listeners
+	size_t last;
+	unsigned long version;
+
+	uint8_t *append(LogEntryType type, const char *format, size_t argsLen);
+	void evictOldest();
+	void notify();
+	LogEntry entryAt(size_t offset);
+
+	template<typename T> static constexpr size_t argSize(T) {
+		static_assert(std::is_integral<T>::value || std::is_enum<T>::value || std::is_floating_point<T>::value,
+			"log arguments must be numbers or C strings");
+		return 1 + 8;
+	}
+	static size_t argSize(const char *value) {
+		return 1 + 1 + stringLength(value);
+	}
+	static size_t argSize(char *value) {
+		return argSize((const char *)value);
+	}
+
+	template<typename T> static uint8_t *putArg(uint8_t *out, T value) {
+		if constexpr (std::is_floating_point<T>::value) {
+			return putNumber(out, ARG_DOUBLE, (double)value);
+		} else if constexpr (std::is_signed<T>::value) {
+			return putNumber(out, ARG_INT, (long long)value);
+		} else {
+			return putNumber(out, ARG_UINT, (unsigned long long)value);
+		}
+	}
+	static uint8_t *putArg(uint8_t *out, const char *value) {
+		uint8_t len = stringLength(value);
+		*out++ = ARG_STRING;
+		*out++ = len;
+		memcpy(out, value, len);
+		return out + len;
+	}
+	static uint8_t *putArg(uint8_t *out, char *value) {
+		return putArg(out, (const char *)value);
+	}
+
+	template<typename T> static uint8_t *putNumber(uint8_t *out, ArgType type, T value) {
+		static_assert(sizeof(T) == 8, "numbers are stored in 8 bytes");
+		*out++ = type;
+		// the arena has no alignment, so never store through a T *
+		memcpy(out, &value, 8);
+		return out + 8;
+	}
+
+	static uint8_t stringLength(const char *value) {
+		uint8_t len = 0;
+		while (value != NULL && len < LOG_MAX_STRING && value[len] != 0) {
+			len++;
+		}
+		return len;
+	}
 
-	void trimLog();
+	friend struct LogEntry;
 };
 
-#endif
\ No newline at end of file
+#endif
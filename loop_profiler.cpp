@@ -0,0 +1,114 @@
+#include "loop_profiler.hpp"
+
+#include <string.h>
+
+#include <Arduino.h>
+
+LoopProfiler::LoopProfiler() : sectionCount(1), current(0), windowStart(0), iterationStart(0), lastMark(0) {
+	for (auto &section : sections) {
+		section.name = NULL;
+		clear(section.windows[0]);
+		clear(section.windows[1]);
+		section.overBudget = 0;
+	}
+	sections[0].name = "loop";
+}
+
+int LoopProfiler::addSection(const char *name) {
+	if (sectionCount > LOOP_PROFILER_SECTIONS) {
+		return -1;
+	}
+
+	sections[sectionCount].name = name;
+	return sectionCount++;
+}
+
+void LoopProfiler::begin() {
+	iterationStart = lastMark = micros();
+}
+
+void LoopProfiler::mark(int section) {
+	unsigned long now = micros();
+	if (section > 0 && section < sectionCount) {
+		record(sections[section], now - lastMark);
+	}
+	lastMark = now;
+}
+
+void LoopProfiler::end() {
+	record(sections[0], micros() - iterationStart);
+
+	unsigned long now = millis();
+	if (now - windowStart >= LOOP_PROFILER_WINDOW) {
+		current = 1 - current;
+		for (int i = 0; i < sectionCount; ++i) {
+			clear(sections[i].windows[current]);
+		}
+		windowStart = now;
+	}
+}
+
+void LoopProfiler::record(Section &section, unsigned long micros) {
+	Window &window = section.windows[current];
+
+	// bucket 0 is under 16us, and each after that twice as wide as the one before
+	int bucket = 0;
+	if (micros >= 16) {
+		bucket = 32 - __builtin_clz(micros >> 4);
+		if (bucket >= BUCKETS) {
+			bucket = BUCKETS - 1;
+		}
+	}
+	window.buckets[bucket]++;
+
+	if (window.iterations == 0 || micros < window.min) {
+		window.min = micros;
+	}
+	if (micros > window.max) {
+		window.max = micros;
+	}
+	window.total += micros;
+	window.iterations++;
+
+	if (micros > LOOP_PROFILER_BUDGET) {
+		section.overBudget++;
+	}
+}
+
+void LoopProfiler::clear(Window &window) {
+	memset(&window, 0, sizeof(window));
+}
+
+bool LoopProfiler::getTiming(int index, Timing &timing) {
+	if (index < 0 || index >= sectionCount) {
+		return false;
+	}
+
+	const Section &section = sections[index];
+	const Window &older = section.windows[1 - current], &newer = section.windows[current];
+
+	timing.name = section.name;
+	timing.overBudget = section.overBudget;
+	timing.iterations = older.iterations + newer.iterations;
+	timing.max = older.max > newer.max ? older.max : newer.max;
+	if (older.iterations == 0 || newer.iterations == 0) {
+		timing.min = older.iterations == 0 ? newer.min : older.min;
+	} else {
+		timing.min = older.min < newer.min ? older.min : newer.min;
+	}
+	timing.average = timing.iterations > 0 ? (older.total + newer.total) / timing.iterations : 0;
+
+	// the smallest bucket that at least 99% of iterations fit in
+	unsigned long needed = timing.iterations - timing.iterations / 100, seen = 0;
+	timing.p99 = timing.max;
+	for (int bucket = 0; bucket < BUCKETS - 1; ++bucket) {
+		seen += older.buckets[bucket] + newer.buckets[bucket];
+		if (seen >= needed) {
+			unsigned long top = (16ul << bucket) - 1;
+			timing.p99 = top < timing.max ? top : timing.max;
+			break;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,84 @@
+#ifndef LOOP_PROFILER_HPP
+#define LOOP_PROFILER_HPP
+
+// default of up to 6 subsystems timed, besides the loop as a whole
+#define LOOP_PROFILER_SECTIONS 6
+
+// default of timings covering the last 10 to 20 seconds: they're kept in two 10 second halves, and
+// the older half is thrown away as each new one starts
+#define LOOP_PROFILER_WINDOW 10000
+
+// default budget of 10ms for one pass through the loop; at 115200 baud the 256 byte serial receive
+// buffer holds about 22ms of what the projector sends, so a loop over budget is halfway to losing data
+#define LOOP_PROFILER_BUDGET 10000
+
+#include <stddef.h>
+
+/**
+ * Times each pass through the main loop and each subsystem within it, to find which one holds up
+ * everything else. Timing an iteration is a few calls to micros() and, for each section, a handful
+ * of additions and a counter increment in a power-of-two bucket, so it's cheap enough to leave on.
+ *
+ *     profiler.begin();
+ *     projector.loop();
+ *     profiler.mark(projectorSection);
+ *     ...
+ *     profiler.end();
+ *
+ * Minimum, average, maximum and 99th percentile are over the last LOOP_PROFILER_WINDOW to twice
+ * that; the percentile is the top of the bucket it falls in (no more than the maximum), so it's
+ * only ever an overestimate, and by less than double.
+ */
+class LoopProfiler {
+public:
+
+	struct Timing {
+		const char *name;
+		unsigned long iterations;
+		// in microseconds
+		unsigned long min, average, p99, max;
+		// since boot, not just over the window
+		long overBudget;
+	};
+
+	LoopProfiler();
+
+	// returns the section to pass to mark(), or -1 if there's no room for another
+	int addSection(const char *name);
+
+	void begin();
+	// attributes the time since begin() or the last mark() to the section
+	void mark(int section);
+	void end();
+
+	// the whole loop for index 0, then each section in the order added, until it returns false
+	bool getTiming(int index, Timing &timing);
+
+private:
+
+	static constexpr int BUCKETS = 16;
+
+	struct Window {
+		unsigned long iterations, min, max;
+		unsigned long long total;
+		unsigned long buckets[BUCKETS];
+	};
+
+	// the loop as a whole is section 0
+	struct Section {
+		const char *name;
+		Window windows[2];
+		long overBudget;
+	} sections[LOOP_PROFILER_SECTIONS + 1];
+	int sectionCount;
+
+	// which of the windows is filling up
+	int current;
+	unsigned long windowStart;
+	unsigned long iterationStart, lastMark;
+
+	void record(Section &section, unsigned long micros);
+	static void clear(Window &window);
+};
+
+#endif
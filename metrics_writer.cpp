@@ -0,0 +1,28 @@
+#include "config.h"
+#ifdef ENABLE_HTTP
+
+#include "metrics_writer.hpp"
+
+MetricsWriter::MetricsWriter(ChunkedResponse &response) : response(response) {
+}
+
+void MetricsWriter::counter(const char *name, const char *help, unsigned long long value) {
+	family(name, "counter", help);
+	response.printf("%s %llu\n", name, value);
+}
+
+void MetricsWriter::gauge(const char *name, const char *help, double value) {
+	family(name, "gauge", help);
+	response.printf("%s %.10g\n", name, value);
+}
+
+void MetricsWriter::family(const char *name, const char *type, const char *help) {
+	response.printf("# HELP %s %s\n", name, help);
+	response.printf("# TYPE %s %s\n", name, type);
+}
+
+void MetricsWriter::sample(const char *name, const char *label, const char *labelValue, double value) {
+	response.printf("%s{%s=\"%s\"} %.10g\n", name, label, labelValue, value);
+}
+
+#endif
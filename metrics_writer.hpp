@@ -0,0 +1,39 @@
+#ifndef METRICS_WRITER_HPP
+#define METRICS_WRITER_HPP
+
+#include "histogram.hpp"
+#include "http_response.hpp"
+
+/**
+ * Writes metrics in the Prometheus text exposition format (version 0.0.4) to a streamed response,
+ * for /metrics. Every metric gets its # HELP and # TYPE lines, then its samples.
+ */
+class MetricsWriter {
+public:
+
+	MetricsWriter(ChunkedResponse &response);
+
+	void counter(const char *name, const char *help, unsigned long long value);
+	void gauge(const char *name, const char *help, double value);
+
+	// for a metric with a label: the header once, then a sample for each value of the label
+	void family(const char *name, const char *type, const char *help);
+	void sample(const char *name, const char *label, const char *labelValue, double value);
+
+	template<size_t N> void histogram(const char *name, const char *help, const Histogram<N> &histogram) {
+		family(name, "histogram", help);
+
+		for (size_t bucket = 0; bucket < N; ++bucket) {
+			response.printf("%s_bucket{le=\"%lu\"} %lu\n", name, histogram.getBound(bucket), histogram.getCumulativeCount(bucket));
+		}
+		response.printf("%s_bucket{le=\"+Inf\"} %lu\n", name, histogram.getCount());
+		response.printf("%s_sum %llu\n", name, histogram.getSum());
+		response.printf("%s_count %lu\n", name, histogram.getCount());
+	}
+
+private:
+
+	ChunkedResponse &response;
+};
+
+#endif
@@ -4,29 +4,44 @@
 #include "mqtt.hpp"
 
 #include <ArduinoJson.h>
+#include <stdio.h>
 
 using std::bind;
 
 MqttSupport::MqttSupport(
-	Logger &logger, BenQProjector &projector, PowerState &projectorPower,
-	int publishIntervalMs,
+	Logger &logger, BenQProjector &projector, PowerState &projectorPower, StatusCache &status,
+	LoopProfiler &profiler, Scheduler &scheduler,
+	int heartbeatIntervalMs,
 	const char *clientName, const char *server, const short port, const char *username, const char *password,
 	const char *powerSetTopic, const char *volumeSetTopic, const char *sourceSetTopic, const char *lampModeSetTopic,
 	const char *remoteTopic,
 	const char *rawSendTopic,
-	const char *statusTopic
-) : logger(logger), projector(projector), projectorPower(projectorPower),
-	publishInterval(publishIntervalMs),
+	const char *statusTopic,
+	const char *statsTopic
+) : logger(logger), projector(projector), projectorPower(projectorPower), status(status), profiler(profiler), scheduler(scheduler),
 	mqtt(server, port, username, password, clientName),
+	heartbeatInterval(heartbeatIntervalMs),
 	powerSetTopic(powerSetTopic), volumeSetTopic(volumeSetTopic), sourceSetTopic(sourceSetTopic), lampModeSetTopic(lampModeSetTopic),
 	remoteTopic(remoteTopic),
 	rawSendTopic(rawSendTopic),
-	statusTopic(statusTopic) {
+	statusTopic(statusTopic),
+	statsTopic(statsTopic),
+	publishPending(false), lastPublish(0), connections(0),
+	statusTimer(scheduler.add("mqtt status", [this]() { checkStatus(); })),
+	statsTimer(scheduler.add("mqtt stats", [this]() { publishStats(); })) {
+	lastStatus[0] = 0;
 }
 
 void MqttSupport::setup() {
 	// mqtt.enableDebuggingMessages();
 	mqtt.setOnConnectionEstablishedCallback(bind(&MqttSupport::onConnectionEstablished, this));
+
+	status.addChangeListener([this]() {
+		statusChanged();
+	});
+
+	scheduler.after(statusTimer, MQTT_STATUS_DEBOUNCE);
+	scheduler.after(statsTimer, heartbeatInterval);
 }
 
 void MqttSupport::loop() {
@@ -34,31 +49,76 @@ void MqttSupport::loop() {
 }
 
 
-void MqttSupport::publishStatus() {
-	StaticJsonDocument<128> status;
+void MqttSupport::statusChanged() {
+	// changes within the debounce time go out together
+	long remaining = scheduler.getRemaining(statusTimer);
+	if (remaining < 0 || remaining > MQTT_STATUS_DEBOUNCE) {
+		scheduler.after(statusTimer, MQTT_STATUS_DEBOUNCE);
+	}
+}
+
+void MqttSupport::checkStatus() {
+	if (!mqtt.isConnected()) {
+		// it all goes out again once we're connected
+		return;
+	}
+
+	auto now = millis();
+	bool heartbeat = now - lastPublish >= heartbeatInterval;
+	const char *current = status.getJson();
+
+	// (something may have changed that isn't part of the status)
+	if (publishPending || heartbeat || strcmp(current, lastStatus) != 0) {
+		// logger.debug(current);
+
+		if (!mqtt.publish(statusTopic, current)) {
+			scheduler.after(statusTimer, MQTT_STATUS_DEBOUNCE);
+			return;
+		}
 
-	status["power"] = projectorPower.getVirtualPowerState();
-	status["model"] = projector.getModelName();
-	
-	if (projector.isOn()) {
-		status["source"] = projector.getSource();
-		status["volume"] = projector.getVolume();
-		status["lamp_mode"] = projector.getLampMode();
+		strcpy(lastStatus, current);
+		publishPending = false;
+		lastPublish = now;
 	}
 
-	serializeJson(status, lastStatus, 128);
+	// nothing more to do until the status changes, or it's time for a heartbeat
+	scheduler.after(statusTimer, heartbeatInterval - (now - lastPublish));
+}
 
-	// logger.debug(lastStatus);
+void MqttSupport::publishStats() {
+	scheduler.after(statsTimer, heartbeatInterval);
+	if (statsTopic == NULL || !mqtt.isConnected()) {
+		return;
+	}
 
-	mqtt.publish(statusTopic, lastStatus);
+	LoopProfiler::Timing timing;
+	for (int i = 0; profiler.getTiming(i, timing); ++i) {
+		StaticJsonDocument<LOOP_STATS_JSON_SIZE> stats;
+		stats["iterations"] = timing.iterations;
+		stats["min_us"] = timing.min;
+		stats["avg_us"] = timing.average;
+		stats["p99_us"] = timing.p99;
+		stats["max_us"] = timing.max;
+		stats["over_budget"] = timing.overBudget;
+
+		char topic[128], payload[LOOP_STATS_JSON_SIZE];
+		snprintf(topic, sizeof(topic), "%s/%s", statsTopic, timing.name);
+		serializeJson(stats, payload, sizeof(payload));
+		mqtt.publish(topic, payload);
+	}
 }
 
+long MqttSupport::getConnectionCount() {
+	return connections;
+}
 
 void onConnectionEstablished() {
 	// global forced on us; not used
 }
 
 void MqttSupport::onConnectionEstablished() {
+	connections++;
+
 	// we're connected, so set up our subscriptions
 	mqtt.subscribe(powerSetTopic, [this](const String& payload) {
 		const char *val = payload.c_str();
@@ -87,36 +147,12 @@ void MqttSupport::onConnectionEstablished() {
 	});
 
 	mqtt.subscribe(remoteTopic, [this](const String& payload) {
-		const char *val = payload.c_str();
-
-		//TODO: shouldn't this be internal to BenQProjector?
-		if (strcasecmp(val, "INFO") == 0) {
-			// info toggles menu on and off
-			projector.queueRaw("menu");
-		} else if (strcasecmp(val, "BACK") == 0) {
-			// back closes menu
-			projector.queueValue("menu", "off");
-		} else if (strcasecmp(val, "SELECT") == 0) {
-			projector.queueRaw("enter");
-		} else if (strcasecmp(val, "UP") == 0) {
-			projector.queueRaw("up");
-		} else if (strcasecmp(val, "DOWN") == 0) {
-			projector.queueRaw("down");
-		} else if (strcasecmp(val, "LEFT") == 0) {
-			projector.queueRaw("left");
-		} else if (strcasecmp(val, "RIGHT") == 0) {
-			projector.queueRaw("right");
-		}
+		projector.sendRemoteKey(payload.c_str());
 	});
 
-	scheduleMqttStatus();
-}
-
-void MqttSupport::scheduleMqttStatus() {
-	mqtt.executeDelayed(publishInterval, [this]() {
-		publishStatus();
-		scheduleMqttStatus();
-	});
+	// whatever we published before may have been missed while we were disconnected
+	publishPending = true;
+	statusChanged();
 }
 
 #endif
\ No newline at end of file
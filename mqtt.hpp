@@ -1,50 +1,84 @@
 #ifndef MQTT_HPP
 #define MQTT_HPP
 
+// default of publishing status 200ms after it changes; changes within that window go out together
+#define MQTT_STATUS_DEBOUNCE 200
+
+// room for one section's loop timings as JSON
+#define LOOP_STATS_JSON_SIZE 160
+
+// default of not publishing loop timings, for a config.h from before they were (see config.h.sample)
+#ifndef MQTT_STATS_TOPIC
+#define MQTT_STATS_TOPIC NULL
+#endif
+
 #include "logger.hpp"
+#include "loop_profiler.hpp"
 #include "projector.hpp"
 #include "power_state.hpp"
+#include "scheduler.hpp"
+#include "status_cache.hpp"
 
 #include <EspMQTTClient.h>
 
 /**
  * Bundles up the MQTT support in one central place for easy inclusion/exclusion from firmware.
+ *
+ * Status is published as soon as it changes (debounced, so a burst of changes goes out as one
+ * message), on every (re)connect, and every `heartbeatIntervalMs` otherwise.
+ *
+ * Loop timings go out every `heartbeatIntervalMs` too, one message per section to
+ * `<statsTopic>/<section>` (unless statsTopic is NULL).
  */
 class MqttSupport {
 public:
 
 	MqttSupport(
-		Logger &logger, BenQProjector &projector, PowerState &projectorPower,
-		int publishIntervalMs,
+		Logger &logger, BenQProjector &projector, PowerState &projectorPower, StatusCache &status,
+		LoopProfiler &profiler, Scheduler &scheduler,
+		int heartbeatIntervalMs,
 		const char *clientName, const char *server, const short port, const char *username, const char *password,
 		const char *powerSetTopic, const char *volumeSetTopic, const char *sourceSetTopic, const char *lampModeSetTopic,
 		const char *remoteTopic,
 		const char *rawSendTopic,
-		const char *statusTopic
+		const char *statusTopic,
+		const char *statsTopic
 	);
 
 	void setup();
 	void loop();
 
+	// how many times we've connected to the broker, the first time included
+	long getConnectionCount();
+
 private:
 
 	Logger &logger;
 	BenQProjector &projector;
 	PowerState &projectorPower;
+	StatusCache &status;
+	LoopProfiler &profiler;
+	Scheduler &scheduler;
 	EspMQTTClient mqtt;
 
-	int publishInterval;
+	int heartbeatInterval;
 	const char *powerSetTopic, *volumeSetTopic, *sourceSetTopic, *lampModeSetTopic;
 	const char *remoteTopic;
 	const char *rawSendTopic;
 	const char *statusTopic;
+	const char *statsTopic;
 
-	char lastStatus[128];
+	char lastStatus[STATUS_JSON_SIZE];
+	bool publishPending;
+	unsigned long lastPublish;
+	long connections;
+	int statusTimer, statsTimer;
 
 	void onConnectionEstablished();
-	void scheduleMqttStatus();
 
-	void publishStatus();
+	void statusChanged();
+	void checkStatus();
+	void publishStats();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,206 @@
+#ifndef POLL_SCHEDULER_HPP
+#define POLL_SCHEDULER_HPP
+
+// default of polling a key every 2 seconds for 10 seconds after something that could have changed
+// it
+#define POLL_BOOST_INTERVAL 2000
+#define POLL_BOOST_TIME 10000
+
+// default of trying again after 5 seconds when a poll is refused or goes unanswered (e.g. while the
+// projector is warming up)
+#define POLL_RETRY_INTERVAL 5000
+
+// default of +/- 10% on every interval, so keys polled at the same rate drift apart rather than
+// all going out together
+#define POLL_JITTER_PERCENT 10
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+/**
+ * A key to poll, and how often once its value is known. An interval of 0 polls the key until it's
+ * been answered once, and never again after that.
+ */
+struct PollKey {
+	const char *key;
+	unsigned long interval;
+	// the projector only answers while it's on
+	bool onlyWhenOn;
+};
+
+/**
+ * When each of N keys is next due to be polled. Every value that comes in for a key counts,
+ * whether it answered a poll or a command, and pushes its next poll back a whole interval; a
+ * command that could change a key makes it poll every POLL_BOOST_INTERVAL for a while instead, and
+ * a poll that fails is tried again after POLL_RETRY_INTERVAL.
+ *
+ * Times are compared as differences, so they hold across millis() wrapping. Keys that have never
+ * been polled are due straight away.
+ *
+ *     static const PollKey pollKeys[] = { { "pow", 3000, false }, { "vol", 60000, true } };
+ *     PollScheduler<2> polls(pollKeys);
+ */
+template<size_t N> class PollScheduler {
+public:
+
+	explicit PollScheduler(const PollKey (&keys)[N], uint32_t seed = 0x2545F491) : keys(keys), random(seed) {
+		for (size_t i = 0; i < N; ++i) {
+			intervals[i] = keys[i].interval;
+			schedule[i].next = 0;
+			schedule[i].boostUntil = 0;
+			schedule[i].boosted = false;
+			schedule[i].done = false;
+			schedule[i].disabled = false;
+		}
+	}
+
+	static constexpr size_t getKeyCount() {
+		return N;
+	}
+
+	const PollKey &getKey(size_t index) const {
+		return keys[index];
+	}
+
+	// changes a key's interval from the one it was set up with
+	void setInterval(size_t index, unsigned long interval) {
+		intervals[index] = interval;
+	}
+
+	// the index of a key, or -1 if it isn't one of ours
+	int indexOf(const char *key, size_t keyLen) const {
+		for (size_t i = 0; i < N; ++i) {
+			if (strncasecmp(keys[i].key, key, keyLen) == 0 && keys[i].key[keyLen] == 0) {
+				return i;
+			}
+		}
+		return -1;
+	}
+
+	bool isDue(size_t index, unsigned long now) const {
+		return !schedule[index].done && !schedule[index].disabled && (long)(now - schedule[index].next) >= 0;
+	}
+
+	// stops polling a key whatever else happens to it (e.g. the projector doesn't have it), until
+	// it's enabled again
+	void setDisabled(size_t index, bool disabled) {
+		schedule[index].disabled = disabled;
+	}
+
+	bool isDisabled(size_t index) const {
+		return schedule[index].disabled;
+	}
+
+	// the soonest any key is due (which may already have passed)
+	unsigned long getNextDue(unsigned long now) const {
+		unsigned long soonest = now + POLL_BOOST_TIME;
+		for (size_t i = 0; i < N; ++i) {
+			if (!schedule[i].done && !schedule[i].disabled && (long)(schedule[i].next - soonest) < 0) {
+				soonest = schedule[i].next;
+			}
+		}
+		return soonest;
+	}
+
+	// a poll went out; if it goes unanswered, the key is tried again after an interval anyway
+	void polled(size_t index, unsigned long now) {
+		reschedule(index, now);
+	}
+
+	// overrides the schedule for the next poll only
+	void pollAt(size_t index, unsigned long at) {
+		schedule[index].next = at;
+		schedule[index].done = false;
+	}
+
+	// a value came in for the key
+	void confirmed(const char *key, size_t keyLen, unsigned long now) {
+		int index = indexOf(key, keyLen);
+		if (index < 0) {
+			return;
+		}
+
+		if (intervals[index] == 0 && !isBoosted(index, now)) {
+			schedule[index].done = true;
+			return;
+		}
+		reschedule(index, now);
+	}
+
+	// a poll for the key was refused or went unanswered
+	void failed(const char *key, size_t keyLen, unsigned long now) {
+		int index = indexOf(key, keyLen);
+		if (index >= 0) {
+			schedule[index].next = now + jittered(POLL_RETRY_INTERVAL);
+		}
+	}
+
+	// something happened that could change the key; poll it every POLL_BOOST_INTERVAL for a while
+	void boost(const char *key, size_t keyLen, unsigned long now) {
+		int index = indexOf(key, keyLen);
+		if (index >= 0) {
+			boost(index, now);
+		}
+	}
+
+	void boost(size_t index, unsigned long now) {
+		schedule[index].boostUntil = now + POLL_BOOST_TIME;
+		schedule[index].boosted = true;
+		schedule[index].done = false;
+
+		if ((long)(schedule[index].next - (now + POLL_BOOST_INTERVAL)) > 0) {
+			schedule[index].next = now + POLL_BOOST_INTERVAL;
+		}
+	}
+
+	// everything is due now (e.g. after the projector comes on, when all of it will have changed)
+	void pollAllNow(unsigned long now) {
+		for (size_t i = 0; i < N; ++i) {
+			schedule[i].next = now;
+			schedule[i].done = false;
+		}
+	}
+
+private:
+
+	const PollKey (&keys)[N];
+	unsigned long intervals[N];
+	struct {
+		unsigned long next, boostUntil;
+		bool boosted, done, disabled;
+	} schedule[N];
+	uint32_t random;
+
+	bool isBoosted(size_t index, unsigned long now) {
+		if (schedule[index].boosted && (long)(now - schedule[index].boostUntil) >= 0) {
+			schedule[index].boosted = false;
+		}
+		return schedule[index].boosted;
+	}
+
+	void reschedule(size_t index, unsigned long now) {
+		unsigned long interval = intervals[index];
+		if (isBoosted(index, now) && (interval == 0 || interval > POLL_BOOST_INTERVAL)) {
+			interval = POLL_BOOST_INTERVAL;
+		} else if (interval == 0) {
+			// not answered yet; keep asking
+			interval = POLL_BOOST_INTERVAL;
+		}
+
+		schedule[index].next = now + jittered(interval);
+	}
+
+	unsigned long jittered(unsigned long interval) {
+		// xorshift32
+		random ^= random << 13;
+		random ^= random >> 17;
+		random ^= random << 5;
+
+		unsigned long jitter = interval * POLL_JITTER_PERCENT / 100;
+		return jitter > 0 ? interval - jitter + random % (2 * jitter + 1) : interval;
+	}
+};
+
+#endif
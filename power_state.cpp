@@ -3,84 +3,91 @@
 #include <Arduino.h>
 
 PowerState::PowerState(
-	Logger &logger, BenQProjector &projector,
+	Logger &logger, Scheduler &scheduler, BenQProjector &projector,
 	int minimumOnSeconds, int maximumOnSeconds, int minimumOffSeconds,
 	int virtualOffGracePeriodSeconds,
 	int skipGracePeriodAfterSeconds
 ) :
-	logger(logger), projector(projector),
+	logger(logger), scheduler(scheduler), projector(projector),
 	minimumOnMillis(minimumOnSeconds * 1000), maximumOnMillis(maximumOnSeconds * 1000), minimumOffMillis(minimumOffSeconds * 1000),
 	virtualOffGracePeriodMillis(virtualOffGracePeriodSeconds * 1000), skipGracePeriodAfterMillis(skipGracePeriodAfterSeconds * 1000),
-	initialized(false), lastKnownPowerState(false), lastKnownBlankState(false),
-	offTimeByLimit(-1), pendingOffTime(-1) {
+	offByLimitTimer(scheduler.add("power off by limit", [this]() { offTimeReached(); })),
+	pendingOffTimer(scheduler.add("pending power off", [this]() { offTimeReached(); })),
+	stateVersion(0) {
 }
 
 void PowerState::begin() {
-	// nothing to do at initialization
+	projector.addChangeListener([this](const ProjectorChange &change) {
+		onProjectorChange(change);
+	});
+	projector.addCommandListener([this](const char *command, CommandPriority priority, CommandResult result) {
+		onCommandResult(command, priority, result);
+	});
 }
 
-void PowerState::loop() {
-	long now = millis();
-
-	if (!initialized) {
-		// get our initial state
-		if (projector.isInitialized()) {
-			lastKnownPowerState = projector.isOn();
-
-			if (maximumOnMillis > 0 && lastKnownPowerState) {
-				// we're probably off, but set the limit off time now
-				offTimeByLimit = now + maximumOnMillis;
-			}
-		} else {
-			// don't do anything else until initialized
-			return;
-		}
+void PowerState::onCommandResult(const char *command, CommandPriority priority, CommandResult result) {
+	// we only care about our own scheduled power offs (those go in the state lane)
+	if (priority != PRIORITY_STATE || result == COMMAND_OK || strcasecmp(command, "pow=off") != 0) {
+		return;
 	}
 
-	bool nextOn = projector.isOn();
-	bool nextBlank = projector.isImageBlanked();
+	if (projector.isOn()) {
+		// the projector refused it or never answered (e.g. it was still warming up), so try again
+		// in a bit rather than leaving it on indefinitely
+		setPendingOff(POWER_STATE_RETRY_INTERVAL);
 
-	if (nextOn && !nextBlank && lastKnownBlankState) {
-		// blanking was turned off manually, so treat that as a 'power on' and cancel out the
-		// pending off
-		pendingOffTime = -1;
+		logger.info("Scheduled power off didn't go through; will try again shortly");
 	}
+}
 
-	if (nextOn == lastKnownPowerState) {
-		// projector hasn't turned on or off on this loop, so check and see if we need to do
-		// anything
-		if ((pendingOffTime > 0 && now >= pendingOffTime) || (offTimeByLimit > 0 && now >= offTimeByLimit)) {
-			// do the actual shutdown
-			projector.turnOff();
-			pendingOffTime = -1;
-			offTimeByLimit = -1;
-		}
-	} else {
-		// projector has turned on or off, so cancel out any pending operations
-		pendingOffTime = -1;
-		offTimeByLimit = -1;
+void PowerState::onProjectorChange(const ProjectorChange &change) {
+	switch (change.field) {
+		case FIELD_POWER:
+			// projector has turned on or off (or we've just found out which), so cancel out any
+			// pending operations
+			setPendingOff(-1);
+			setOffByLimit(-1);
+
+			if (maximumOnMillis > 0 && change.on) {
+				// projector turned on, so queue our off-by-limit
+				setOffByLimit(maximumOnMillis);
+			}
+			break;
 
-		if (maximumOnMillis > 0 && nextOn) {
-			// projector turned on, so queue our off-by-limit
-			offTimeByLimit = now + maximumOnMillis;
-		}
+		case FIELD_BLANK:
+			if (!change.on && projector.isOn()) {
+				// blanking was turned off manually, so treat that as a 'power on' and cancel out
+				// the pending off
+				setPendingOff(-1);
+			}
+			break;
+
+		default:
+			break;
 	}
 }
 
-bool PowerState::requestPowerOn() {
-	long now = millis();
+void PowerState::offTimeReached() {
+	// do the actual shutdown
+	projector.turnOff(PRIORITY_STATE);
+	setPendingOff(-1);
+	setOffByLimit(-1);
+	// (the timer that went off isn't pending any more, so the above didn't count it)
+	changed();
+}
 
+bool PowerState::requestPowerOn() {
 	if (projector.isOn()) {
-		if (pendingOffTime > 0) {
+		if (scheduler.isPending(pendingOffTimer)) {
 			// projector is on, but was "virtually off" - so turn it "back on"
 			projector.setImageBlank(false);
-			pendingOffTime = -1;
+			setPendingOff(-1);
 			return true;
 		} else {
 			// projector is on and not "virtually off" - so we can't do anything
 			return false;
 		}
-	} else if ((now - projector.getLastOffTime()) < minimumOffMillis) {
+	} else if (millis() - projector.getLastOffTime() < (unsigned long)minimumOffMillis) {
 		// projector is off but hasn't been off for long enough
 		return false;
 	} else {
@@ -91,10 +98,8 @@ bool PowerState::requestPowerOn() {
 }
 
 void PowerState::requestPowerOff() {
-	long now = millis();
-
-	if (projector.isOn() && pendingOffTime > 0) {
-		auto onTime = now - projector.getLastOnTime();
+	if (projector.isOn() && !scheduler.isPending(pendingOffTimer)) {
+		long onTime = millis() - projector.getLastOnTime();
 
 		// projector is on and not already pending being turned off
 		if (onTime >= skipGracePeriodAfterMillis && onTime >= minimumOnMillis) {
@@ -109,40 +114,88 @@ void PowerState::requestPowerOff() {
 				// "virtual off" time; note that the minimum on time starts from the on time, so
 				// we subtract however long it was on (i.e, if it was on for 4 minutes but the
 				// minimum was 5, we only have to delay 1 more minute)
-				pendingOffTime = now + minimumOnMillis - onTime;
+				setPendingOff(minimumOnMillis - onTime);
 			} else {
 				// either we've met the minimum on time, or the "virtual off" time is greater
 				// than the minimum on time anyway
-				pendingOffTime = now + virtualOffGracePeriodMillis;
+				setPendingOff(virtualOffGracePeriodMillis);
 			}
 		}
 	}
 }
 
 // we consider the projector on if, on last check, it was on and didn't have a pending off time
-bool PowerState::getVirtualPowerState() { return projector.isOn() && (pendingOffTime <= 0); }
+bool PowerState::getVirtualPowerState() { return projector.isOn() && !scheduler.isPending(pendingOffTimer); }
 bool PowerState::getRealPowerState() { return projector.isOn(); }
 
-long PowerState::getPendingRealOffTime() {
+unsigned long PowerState::getStateVersion() { return stateVersion; }
+
+void PowerState::addChangeListener(std::function<void()> listener) {
+	changeListeners.push_back(listener);
+}
+
+void PowerState::changed() {
+	stateVersion++;
+
+	for (auto &listener : changeListeners) {
+		listener();
+	}
+}
+
+PowerState::Snapshot PowerState::getSnapshot() {
+	Snapshot snapshot;
+
+	snapshot.version = stateVersion;
+	snapshot.virtualPowerState = getVirtualPowerState();
+	snapshot.timeUntilRealOff = getTimeUntilRealOff();
+
+	return snapshot;
+}
+
+// -1 cancels it
+void PowerState::setPendingOff(long delayMs) {
+	if (delayMs >= 0) {
+		scheduler.after(pendingOffTimer, delayMs);
+		changed();
+	} else if (scheduler.isPending(pendingOffTimer)) {
+		scheduler.cancel(pendingOffTimer);
+		changed();
+	}
+}
+
+void PowerState::setOffByLimit(long delayMs) {
+	if (delayMs >= 0) {
+		scheduler.after(offByLimitTimer, delayMs);
+		changed();
+	} else if (scheduler.isPending(offByLimitTimer)) {
+		scheduler.cancel(offByLimitTimer);
+		changed();
+	}
+}
+
+long PowerState::getTimeUntilRealOff() {
 	// return the soonest off time
-	if (offTimeByLimit > 0 && offTimeByLimit < pendingOffTime) {
-		return offTimeByLimit;
+	long byLimit = scheduler.getRemaining(offByLimitTimer);
+	long pending = scheduler.getRemaining(pendingOffTimer);
+
+	if (byLimit >= 0 && (pending < 0 || byLimit < pending)) {
+		return byLimit;
 	} else {
-		return pendingOffTime;
+		return pending;
 	}
 }
 
 void PowerState::cancelOffByLimit() {
 	// turn off the limit-off this time around
-	offTimeByLimit = -1;
+	setOffByLimit(-1);
 }
 
-long PowerState::getAllowedOnTime() {
-	// get the time we're allowing a turn-on
-	auto turnOnTime = projector.getLastOffTime() + minimumOffMillis;
+long PowerState::getTimeUntilOnAllowed() {
+	// how long until we allow a turn-on
+	unsigned long offFor = millis() - projector.getLastOffTime();
 
-	if (!projector.isOn() && millis() < turnOnTime) {
-		return turnOnTime;
+	if (!projector.isOn() && offFor < (unsigned long)minimumOffMillis) {
+		return minimumOffMillis - offFor;
 	}
 
 	return -1;
@@ -1,8 +1,15 @@
 #ifndef POWER_STATE_HPP
 #define POWER_STATE_HPP
 
+// default of 30 seconds before trying a scheduled power off again, if the projector refused it
+#define POWER_STATE_RETRY_INTERVAL 30000
+
 #include "logger.hpp"
 #include "projector.hpp"
+#include "scheduler.hpp"
+
+#include <functional>
+#include <list>
 
 /**
  * This is a simple state machine for managing the power state of the projetor. We apply several
@@ -15,12 +22,13 @@
  *   This can be temporarily overridden via HTTP or MQTT on a case by case basis.
  * 
  * This is meant to wrap a BenQProjector instance and serve as a proxy for power state control.
+ * It follows the projector through its change listeners, so there's nothing to do between frames.
  */
 class PowerState {
 public:
 
 	PowerState(
-		Logger &logger, BenQProjector &projector,
+		Logger &logger, Scheduler &scheduler, BenQProjector &projector,
 		// the on/off time limits; 0 to disable
 		int minimumOnSeconds, int maximumOnSeconds, int minimumOffSeconds,
 		// the "grace period" for the virtual off time
@@ -30,7 +38,6 @@ public:
 	);
 
 	void begin();
-	void loop();
 
 	bool requestPowerOn(); // returns false if the projector can't be turned on right now
 	void requestPowerOff();
@@ -38,24 +45,53 @@ public:
 	bool getVirtualPowerState();
 	bool getRealPowerState();
 
-	long getPendingRealOffTime();
+	/**
+	 * Our own state at one point in time (the projector's is in BenQProjector::Snapshot). The
+	 * version goes up every time a pending off changes, which is all that can change the virtual
+	 * power state short of the projector itself turning on or off.
+	 */
+	struct Snapshot {
+		unsigned long version;
+		bool virtualPowerState;
+		long timeUntilRealOff;
+	};
+
+	unsigned long getStateVersion();
+	Snapshot getSnapshot();
+
+	// called whenever the state version moves on
+	void addChangeListener(std::function<void()> listener);
+
+	// how long (in ms) until we turn the projector off, whichever of a virtual off or the on time
+	// limit comes first; -1 if neither is pending
+	long getTimeUntilRealOff();
 	void cancelOffByLimit();
 
-	long getAllowedOnTime();
+	// how long (in ms) until the projector may be turned on again; -1 if it's on or allowed now
+	long getTimeUntilOnAllowed();
 
 private:
 
 	Logger &logger;
+	Scheduler &scheduler;
 	BenQProjector &projector;
 	int minimumOnMillis, maximumOnMillis, minimumOffMillis;
 	int virtualOffGracePeriodMillis, skipGracePeriodAfterMillis;
 
-	// projector state tracking
-	bool initialized, lastKnownPowerState, lastKnownBlankState;
-
 	// our own state
-	long offTimeByLimit; // pending power off time due to on-time limit
-	long pendingOffTime; // pending off time for a virtual power off
+	int offByLimitTimer; // pending power off due to on-time limit
+	int pendingOffTimer; // pending off for a virtual power off
+
+	unsigned long stateVersion;
+	std::list<std::function<void()>> changeListeners;
+
+	void changed();
+	void setPendingOff(long delayMs);
+	void setOffByLimit(long delayMs);
+	void offTimeReached();
+
+	void onProjectorChange(const ProjectorChange &change);
+	void onCommandResult(const char *command, CommandPriority priority, CommandResult result);
 };
 
 #endif
\ No newline at end of file
@@ -1,391 +1,834 @@
 #include "projector.hpp"
 
-#include <sstream>
+#include "key_table.hpp"
 
-#include <Arduino.h>
+#include <algorithm>
+#include <stddef.h>
 
-using std::stringstream;
+#include <Arduino.h>
 
-BenQProjector::BenQProjector(Logger &logger, HardwareSerial &in, HardwareSerial &out, int pollIntervalSecs) :
-	logger(logger),
-	in(in), out(out), nextSend(0),
-	pollInterval(pollIntervalSecs * 1000), nextUpdate(0),
+// upper bounds of the response time buckets, in ms; the projector usually answers in about 20
+static const unsigned long responseLatencyBounds[] = { 5, 10, 20, 30, 50, 75, 100, 200, 500, 1000 };
+
+// what gets polled, and how often once it's known; power comes first, then the key that's watched
+// for the end of a warm-up
+static const size_t POLL_POWER = 0, POLL_WARM_UP_PROBE = 1;
+static const PollKey pollKeys[] = {
+	// (set to the constructor's poll interval)
+	{ "pow", PROJECTOR_SEND_INTERVAL, false },
+	{ "sour", PROJECTOR_POLL_STATUS_INTERVAL, true },
+	{ "vol", PROJECTOR_POLL_STATUS_INTERVAL, true },
+	{ "mute", PROJECTOR_POLL_STATUS_INTERVAL, true },
+	{ "blank", PROJECTOR_POLL_STATUS_INTERVAL, true },
+	{ "freeze", PROJECTOR_POLL_STATUS_INTERVAL, true },
+	{ "lampm", PROJECTOR_POLL_LAMP_MODE_INTERVAL, true },
+	// we can query lamp hours when the projector is off, but it won't go up then (see updateState)
+	{ "ltim", PROJECTOR_POLL_LAMP_HOURS_INTERVAL, false },
+	// model name won't change, but we can't get it when it's off
+	{ "modelname", 0, true },
+};
+
+static_assert(sizeof(pollKeys) / sizeof(pollKeys[0]) <= 16, "each poll key needs a bit of Persisted::unsupportedPolls");
+
+// the layout of Persisted; a record of any other version is ignored
+static const uint16_t PERSISTED_VERSION = 1;
+static const uint8_t PERSISTED_OFF = 0, PERSISTED_ON = 1, PERSISTED_COOLING_DOWN = 2;
+
+BenQProjector::BenQProjector(Logger &logger, Scheduler &scheduler, StateStore &store, HardwareSerial &in, HardwareSerial &out, int pollIntervalSecs) :
+	logger(logger), scheduler(scheduler), store(store),
+	in(in), out(out), sendTimer(scheduler.add("projector send", [this]() { checkForSend(); })),
+	pollInterval(pollIntervalSecs * 1000), polls(pollKeys), pollTimer(scheduler.add("projector poll", [this]() { pollDue(); })),
+	etaTimer(scheduler.add("projector eta", [this]() { changed(FIELD_TRANSITION); scheduleEta(); })),
 	// don't queue more polling messages if the queue is larger than will be clared out during one
 	// interval (i.e., polling every 1000ms and sending every 100, cap the queue at 10 messages)
-	maxQueueSizeForPoll(pollInterval / PROJECTOR_SEND_INTERVAL),
+	maxQueueSizeForPoll(std::min(pollInterval / PROJECTOR_SEND_INTERVAL, PROJECTOR_POLL_QUEUE_DEPTH)),
 	lastOn(0), lastOff(0),
-	last10s(0), last60s(0), last360s(0) {
+	recvBudget(PROJECTOR_RECV_BUDGET),
+	stateVersion(0),
+	responseLatency(responseLatencyBounds) {
+
+	polls.setInterval(POLL_POWER, pollInterval);
 }
 
 void BenQProjector::begin() {
-	last10s = last60s = last360s = millis();
+	restore();
 
 	updateState();
 }
 
-void BenQProjector::loop() {
-	auto now = millis();
-	if (now >= nextUpdate && sendQueue.size() < maxQueueSizeForPoll) {
-		updateState();
-		nextUpdate = now + pollInterval;
+void BenQProjector::restore() {
+	Persisted persisted;
+	if (!store.load(PERSISTED_VERSION, &persisted, sizeof(persisted))) {
+		logger.info("No saved projector state; starting from scratch");
+		return;
 	}
 
-	// read and process any incoming data
-	bool handledData = checkForRecv();
+	persisted.modelName[sizeof(persisted.modelName) - 1] = 0;
+	strcpy(state.modelName, persisted.modelName);
+	// (which also means it isn't asked for while the projector is off; see updateState)
+	state.lampHours = persisted.lampHours;
+	transitions.restore(persisted.learned);
 
-	// if we didn't handle any incoming data, process our send queue (to keep loops short)
-	if (!handledData) {
-		checkForSend();
+	// neither needs asking about again straight away: the model name won't have changed, and lamp
+	// hours are only ever an interval out of date anyway
+	if (state.modelName[0] != 0) {
+		polls.confirmed("modelname", strlen("modelname"), millis());
+	}
+	if (state.lampHours > 0) {
+		polls.confirmed("ltim", strlen("ltim"), millis());
 	}
 
-	// update send/recv stats
-	if (now > (last10s + 10000)) {
-		sendStats.last10s = sendStats.current10s;
-		sendStats.last10sRate = 1000.0f * sendStats.last10s / (now - last10s);
-		sendStats.current10s = 0;
+	for (size_t i = 0; i < polls.getKeyCount(); ++i) {
+		polls.setDisabled(i, (persisted.unsupportedPolls & (1 << i)) != 0);
+	}
 
-		recvStats.last10s = recvStats.current10s;
-		recvStats.last10sRate = 1000.0f * recvStats.last10s / (now - last10s);
-		recvStats.current10s = 0;
+	if (persisted.power == PERSISTED_COOLING_DOWN) {
+		// we went down part way through a cool-down; there's no telling how far through (millis()
+		// starts again from 0), so take it as having just started. That keeps the projector from
+		// being turned back on too soon, and an "on" it reports in the meantime from being believed
+		state.isTransitioning = true;
+		state.statusStr = "Powering off...";
+		lastOff = millis();
+	}
 
-		last10s = now;
+	logger.info("Restored projector state: model %s, %d lamp hours", state.modelName[0] != 0 ? state.modelName : "unknown", state.lampHours);
+	stateVersion++;
+}
+
+void BenQProjector::persist() {
+	Persisted persisted;
+	// (padding included, since the store compares records byte for byte)
+	memset(&persisted, 0, sizeof(persisted));
+
+	memcpy(persisted.modelName, state.modelName, sizeof(persisted.modelName));
+	persisted.lampHours = state.lampHours;
+	persisted.learned = transitions.getLearned();
+	for (size_t i = 0; i < polls.getKeyCount(); ++i) {
+		if (polls.isDisabled(i)) {
+			persisted.unsupportedPolls |= 1 << i;
+		}
 	}
+	persisted.power = state.isOn ? PERSISTED_ON : state.isTransitioning ? PERSISTED_COOLING_DOWN : PERSISTED_OFF;
 
-	if (now > (last60s + 60000)) {
-		sendStats.last60s = sendStats.current60s;
-		sendStats.last60sRate = 1000.0f * sendStats.last60s / (now - last60s);
-		sendStats.current60s = 0;
+	store.save(PERSISTED_VERSION, &persisted, sizeof(persisted));
+}
 
-		recvStats.last60s = recvStats.current60s;
-		recvStats.last60sRate = 1000.0f * recvStats.last60s / (now - last60s);
-		recvStats.current60s = 0;
+void BenQProjector::loop() {
+	// read and process any incoming data; an answer frees the projector up, which arms the send
+	// timer for the next command
+	checkForRecv();
+}
 
-		last60s = now;
+void BenQProjector::pollDue() {
+	// don't queue more polls than will go out in one interval; sending one makes room, and
+	// brings us back here
+	if (sendQueue.size(PRIORITY_POLL) >= maxQueueSizeForPoll) {
+		return;
 	}
 
-	if (now > (last360s + 360000)) {
-		sendStats.last360s = sendStats.current360s;
-		sendStats.last360sRate = 1000.0f * sendStats.last360s / (now - last360s);
-		sendStats.current360s = 0;
+	updateState();
+}
+
+void BenQProjector::updateState() {
+	auto now = millis();
+
+	int probe = getTransitionProbe();
+
+	for (size_t i = 0; i < polls.getKeyCount(); ++i) {
+		const PollKey &poll = polls.getKey(i);
+		if (!polls.isDue(i, now)) {
+			continue;
+		}
+
+		if (probe == (int)i) {
+			// there's nothing to see until about when the transition should finish, and then we
+			// want to see it as soon as it does
+			unsigned long opensAt;
+			switch (transitions.getWindow(now, opensAt)) {
+				case TransitionModel::BEFORE_WINDOW:
+					polls.pollAt(i, opensAt);
+					continue;
+				case TransitionModel::IN_WINDOW:
+					queueQuery(poll.key, PRIORITY_POLL);
+					polls.pollAt(i, now + PROJECTOR_TRANSITION_POLL_INTERVAL);
+					continue;
+				default:
+					// we don't know when it'll finish, or it's late; carry on as usual
+					break;
+			}
+		} else if (poll.onlyWhenOn && transitions.getTransition() == TransitionModel::TRANSITION_WARM_UP) {
+			// all of these would be blocked, and they'll be polled when it's warmed up
+			polls.polled(i, now);
+			continue;
+		}
 
-		recvStats.last360s = recvStats.current360s;
-		recvStats.last360sRate = 1000.0f * recvStats.last360s / (now - last360s);
-		recvStats.current360s = 0;
+		// the projector only lets us query most things when it's on, and we can query lamp hours
+		// when it's off, but only do that if we don't know yet (since it won't go up while off);
+		// either way, it's all polled again as soon as the projector comes on
+		bool skip = (poll.onlyWhenOn && !state.isOn) || (strcmp(poll.key, "ltim") == 0 && !state.isOn && state.lampHours != 0);
 
-		last360s = now;
+		if (!skip) {
+			queueQuery(poll.key, PRIORITY_POLL);
+		}
+		polls.polled(i, now);
 	}
+
+	scheduler.at(pollTimer, polls.getNextDue(now));
 }
 
-void BenQProjector::updateState() {
-	queueQuery("pow");
 
-	if (state.isOn) {
-		// the projector only lets us query these items when it's on
-		queueQuery("sour");
-		queueQuery("vol");
-		queueQuery("mute");
-		queueQuery("lampm");
-		queueQuery("blank");
-		queueQuery("freeze");
-
-		// model name won't change, but we can't get it when it's off
-		if (state.modelName[0] == 0 || state.modelName[0] == '?') {
-			queueQuery("modelname");
+int BenQProjector::checkForRecv() {
+	unsigned long start = micros();
+	int frames = 0;
+
+	// handle every complete frame that's come in, unless that takes longer than our budget, in
+	// which case the rest waits for the next loop
+	while (in.available() > 0) {
+		if (!recvParser.push(in.read())) {
+			continue;
+		}
+
+		frames++;
+		receiveFrame(recvParser.frame());
+
+		if (micros() - start >= recvBudget && in.available() > 0) {
+			recvLoop.overruns++;
+			break;
 		}
 	}
 
-	if (state.isOn || state.lampHours == 0) {
-		// we can query lamp hours when projector is off, but only do that if we don't know yet
-		// (since it won't go up otherwise while off)
-		queueQuery("ltim");
+	if (frames > 0) {
+		recvLoop.loops++;
+		recvLoop.frames += frames;
+		recvLoop.maxFrames = std::max(recvLoop.maxFrames, frames);
 	}
+
+	return frames;
 }
 
+void BenQProjector::receiveFrame(const Frame &frame) {
+	switch (frame.type) {
+		case FRAME_OVERFLOW: {
+			frameErrors.overflowed++;
+			logger.error("Dropping message longer than %d bytes; message began with: %s", PROJECTOR_RECV_BUFFER_SIZE, frame.line);
+			break;
+		}
 
-bool BenQProjector::checkForRecv() {
-	bool gotMessage = false;
+		case FRAME_MALFORMED:
+			frameErrors.malformed++;
+			logger.commRecv("%s", frame.line);
+			logger.error("%s", frame.error);
 
-	// read data, while there is some to read
-	while (!gotMessage && in.available() > 0) {
-		char read = in.read();
+			if (!isprint(frame.line[0])) {
+				logger.debug("(first character was unprintable, ASCII=%d)", (int)frame.line[0]);
+			}
+			break;
 
-		// in case we get a really long message, guard against overflow by throwing it away
-		if (recvBuffer.idx == PROJECTOR_RECV_BUFFER_SIZE) {
-			if (read == '\r') {
-				recvBuffer.data[PROJECTOR_RECV_BUFFER_SIZE - 1] = 0;
+		case FRAME_ECHO:
+			recvStats.add();
 
-				stringstream log;
-				log << "Dropping message longer than " << PROJECTOR_RECV_BUFFER_SIZE << " bytes; message began with: " << recvBuffer.data;
-				logger.error(log.str());
+			logger.commEcho("%.*s", (int)frame.bodyLen, frame.body);
 
-				// looks like we ended the message, so reset the buffer and continue on our way
-				recvBuffer.idx = 0;
+			if (inFlight.awaitingResponse && strncasecmp(frame.body, inFlight.command, frame.bodyLen) == 0 && inFlight.command[frame.bodyLen] == 0) {
+				// the projector got what we sent; the answer comes next
+				inFlight.echoed = true;
 			}
+			break;
 
-			// just keep reading and dumping now
-			continue;
-		}
+		case FRAME_MESSAGE:
+			recvStats.add();
 
-		recvBuffer.data[recvBuffer.idx++] = read;
+			logger.commRecv("%s", frame.line);
+			receiveMessage(frame);
+			break;
+	}
+}
 
-		// spec says messages are delimited by \r, but my projector was giving me \r\n
-		if (read == '\r' || read == '\n') {
-			int readBytes = recvBuffer.idx;
-			recvBuffer.data[readBytes - 1] = 0; // NULL out the termination character we read
-			recvBuffer.idx = 0; // reset our receive buffer for next time
+void BenQProjector::receiveMessage(const Frame &frame) {
+	struct ErrorReply {
+		const char *key;
+		CommandResult result;
+	};
+
+	static constexpr ErrorReply errors[] = {
+		{ "Illegal format", COMMAND_ILLEGAL_FORMAT },
+		{ "Block item", COMMAND_BLOCKED },
+		{ "Unsupported item", COMMAND_UNSUPPORTED },
+	};
+	static constexpr KeyTable<ErrorReply, sizeof(errors) / sizeof(errors[0])> errorTable(errors);
+
+	// errors are only ever an answer to what we just sent
+	bool answersInFlight = inFlight.awaitingResponse && inFlight.echoed;
+	const ErrorReply *error = frame.hasValue ? NULL : errorTable.find(frame.key, frame.keyLen);
+
+	if (error != NULL) {
+		switch (error->result) {
+			case COMMAND_ILLEGAL_FORMAT:
+				// we sent a bad message
+				errorReplies.illegalFormat++;
+				logger.error("Illegal format response from projector for %s; did we send an incorrectly formatted message?", answersInFlight ? inFlight.command : "unknown command");
+				break;
+			case COMMAND_BLOCKED:
+				// whatever command we tried to run can't be run now
+				errorReplies.blocked++;
+				logger.info("Command %s%swas blocked by projector; incorrect projector state?", answersInFlight ? inFlight.command : "", answersInFlight ? " " : "");
+				break;
+			default:
+				// we did something that's not supported
+				errorReplies.unsupported++;
+				logger.error("Unsupported response from projector for %s", answersInFlight ? inFlight.command : "unknown command");
+				break;
+		}
 
-			if (readBytes > 1) {
-				// if we read more than just that termination character, attempt to process it
-				gotMessage = true;
-				char *msg = recvBuffer.data;
+		if (answersInFlight) {
+			responseReceived(error->result);
+		}
+		return;
+	}
 
-				// count any echo or valid-looking message
-				if (msg[0] == '>' || msg[0] == '*') {
-					recvStats.total++;
-					recvStats.current10s++; recvStats.current60s++; recvStats.current360s++;
-				}
+	// now, handle the state update for the message we got
+	receiveValue(frame.key, frame.keyLen, frame.value, frame.valueLen);
 
-				if (msg[0] == '>') {
-					// projector is echos commands back prefixed with a > character
-					// trim off the >* and # pre/postfix and log it
-					msg[readBytes - 2] = 0; // trim off the # at the end
-					msg += 2; // skip ahead 2 more bytes, past the >*
+	if (answersInFlight && isInFlightKey(frame.key, frame.keyLen)) {
+		// that was the answer to what we sent, so we're clear to send again
+		responseReceived(COMMAND_OK);
+	}
+}
 
-					logger.commEcho(msg);
-					continue;
-				}
+static bool isOnValue(const char *value, size_t valueLen) {
+	return valueLen == 2 && strncasecmp(value, "on", 2) == 0;
+}
 
-				logger.commRecv(msg);
+static int parseNumber(const char *value, size_t valueLen) {
+	int number = 0;
+	for (size_t i = 0; i < valueLen && isdigit(value[i]); ++i) {
+		number = number * 10 + (value[i] - '0');
+	}
+	return number;
+}
 
-				// start processing the message!
-				int idx = 0;
+// one line per key we track; anything else the projector reports is ignored
+#define STRING_VALUE(key, field, change) { key, VALUE_STRING, change, offsetof(State, field), sizeof(State::field), nullptr }
+#define ON_OFF_VALUE(key, field, change) { key, VALUE_ON_OFF, change, offsetof(State, field), sizeof(State::field), nullptr }
+#define NUMBER_VALUE(key, field, change) { key, VALUE_NUMBER, change, offsetof(State, field), sizeof(State::field), nullptr }
+#define CUSTOM_VALUE(key, method, change) { key, VALUE_CUSTOM, change, 0, 0, &BenQProjector::method }
+
+void BenQProjector::receiveValue(const char *key, size_t keyLen, const char *value, size_t valueLen) {
+	static constexpr ValueHandler handlers[] = {
+		CUSTOM_VALUE("pow", receivePower, FIELD_POWER),
+		CUSTOM_VALUE("vol", receiveVolume, FIELD_VOLUME),
+		STRING_VALUE("sour", source, FIELD_SOURCE),
+		ON_OFF_VALUE("mute", isMuted, FIELD_MUTE),
+		STRING_VALUE("lampm", lampMode, FIELD_LAMP_MODE),
+		ON_OFF_VALUE("blank", isImageBlanked, FIELD_BLANK),
+		ON_OFF_VALUE("freeze", isImageFrozen, FIELD_FREEZE),
+		NUMBER_VALUE("ltim", lampHours, FIELD_LAMP_HOURS),
+		STRING_VALUE("modelname", modelName, FIELD_MODEL_NAME),
+		STRING_VALUE("3d", threeDMode, FIELD_3D_MODE),
+		STRING_VALUE("pp", pictureMode, FIELD_PICTURE_MODE),
+		STRING_VALUE("ct", colorTemp, FIELD_COLOR_TEMP),
+	};
+	static constexpr KeyTable<ValueHandler, sizeof(handlers) / sizeof(handlers[0])> table(handlers);
+	static_assert(sizeof(handlers) / sizeof(handlers[0]) == VALUE_KEYS, "VALUE_KEYS must match the handlers");
+
+	const ValueHandler *handler = table.find(key, keyLen);
+	if (handler == NULL) {
+		return;
+	}
 
-				// messages begin with a *
-				if (msg[idx] != '*') {
-					// invalid message
-					logger.error("Received message didn't start with '*'; gibberish?");
+	auto &seen = valueSeen[handler - handlers];
+	seen.key = handler->key;
+	seen.at = millis();
 
-					if (!isprint(msg[0])) {
-						stringstream log;
-						log << "(first character was unprintable, ASCII=" << (int)msg[0] << ")";
-						logger.debug(log.str());
-					}
+	// whether it answered a poll or not, it's what we'd have polled for
+	polls.confirmed(key, keyLen, seen.at);
 
-					continue;
-				}
+	int pollIndex = polls.indexOf(key, keyLen);
+	if (pollIndex >= 0 && polls.isDisabled(pollIndex)) {
+		// it said it didn't have this before, but it does now (a different projector?)
+		polls.setDisabled(pollIndex, false);
+		persist();
+	}
 
-				// check for error conditions
-				if (strncasecmp(msg, "*Illegal format#", 6) == 0) {
-					// we sent a bad message
-					logger.error("Illegal format response from projector; did we send an incorrectly formatted message?");
-				}
+	if (pollIndex >= 0 && polls.getKey(pollIndex).onlyWhenOn && transitions.getTransition() == TransitionModel::TRANSITION_WARM_UP) {
+		// the projector only answers this once it's fully on
+		if (transitions.finish(seen.at)) {
+			persist();
+		}
+		logger.info("Projector finished warming up after %lums", seen.at - lastOn);
 
-				if (strncasecmp(msg, "*Block item#", 12) == 0) {
-					// whatever command we tried to run can't be run now
-					logger.info("Command was blocked by projector; incorrect projector state?");
-					continue;
-				}
+		// the rest was held back until now
+		polls.pollAllNow(seen.at);
+		scheduler.at(pollTimer, seen.at);
+		scheduleEta();
+		changed(FIELD_TRANSITION);
+	}
 
-				if (strncasecmp(msg, "*Unsupported item#", 18) == 0) {
-					// we did something that's not supported
-					logger.error("Unsupported response from projector");
-					continue;
-				}
-
-				// move past the *
-				idx++;
-				
-				// start reading the key, it will end with an = or a # (if there was no value)
-				char key[16] = "";
-				for (int i = 0; idx < readBytes && i < 15 && msg[idx] != '=' && msg[idx] != '#'; ++idx, ++i) {
-					key[i] = msg[idx];
-				}
-
-				if (msg[idx] != '=' && msg[idx] != '#') {
-					// we didn't get an = or a #, so bad message?
-					logger.error("Was expecting '=' or '#', key/message too long?");
-					continue;
-				}
-
-				if (msg[idx] == '=') {
-					// we did get the =, so continue on
-					idx++;
-				}
-
-				// if we had an =, start reading the value (up to the #)
-				char value[32] = "";
-				if (msg[idx - 1] == '=') {
-					for (int i = 0; idx < readBytes && i < 31 && msg[idx] != '#'; ++idx, ++i) {
-						value[i] = msg[idx];
-					}
-				}
-
-				if (msg[idx] != '#') {
-					// the message didn't end with a # like we expected, so bad message?
-					logger.error("Was expecting '#', value/message too long?");
-					continue;
-				}
+	char *field = (char *)&state + handler->offset;
 
-				// now, handle the state update for the message we got
-				receiveValue(key, value);
+	switch (handler->kind) {
+		case VALUE_STRING:
+			valueLen = std::min(valueLen, handler->size - 1);
+			if (strncmp(field, value, valueLen) != 0 || field[valueLen] != 0) {
+				memcpy(field, value, valueLen);
+				field[valueLen] = 0;
+				changed(handler->field);
 			}
-		}
+			break;
+		case VALUE_ON_OFF:
+			if (*(bool *)field != isOnValue(value, valueLen)) {
+				*(bool *)field = !*(bool *)field;
+				changed(handler->field);
+			}
+			break;
+		case VALUE_NUMBER:
+			if (*(int *)field != parseNumber(value, valueLen)) {
+				*(int *)field = parseNumber(value, valueLen);
+				changed(handler->field);
+			}
+			break;
+		case VALUE_CUSTOM:
+			(this->*handler->receive)(value, valueLen);
+			break;
 	}
 }
 
-void BenQProjector::receiveValue(const char *key, const char *value) {
-	if (strcasecmp(key, "pow") == 0) {
-		bool nextOn = strcasecmp(value, "on") == 0;
+#undef STRING_VALUE
+#undef ON_OFF_VALUE
+#undef NUMBER_VALUE
+#undef CUSTOM_VALUE
+
+void BenQProjector::receivePower(const char *value, size_t valueLen) {
+	bool nextOn = isOnValue(value, valueLen);
+
+	if (!state.initialized && nextOn && isCoolingDown()) {
+		// it was cooling down before a reboot (see restore()), and saying it's on is just it not
+		// being done yet
+		logger.debug("Projector says it's on, but it was cooling down before we restarted");
+
+		state.initialized = true;
+		changed(FIELD_POWER);
+		changed(FIELD_STATUS);
+	} else if (!state.initialized) {
+		// take the first power state no matter what
+		if (nextOn) {
+			state.statusStr = "On";
+			lastOn = millis();
+		} else {
+			state.statusStr = "Off";
+			lastOff = millis();
+		}
 
-		if (!state.initialized) {
-			// take the first power state no matter what
-			if (nextOn) {
-				state.statusStr = "On";
-				lastOn = millis();
-			} else {
-				state.statusStr = "Off";
-				lastOff = millis();
-			}
+		logger.debug("Took initial power value of %d from projector", nextOn);
+
+		state.isOn = nextOn;
+		state.isTransitioning = false;
+		state.initialized = true;
+		changed(FIELD_POWER);
+		changed(FIELD_STATUS);
+	} else if (state.isOn && !nextOn) {
+		// projector reports off, so clear values back to defaults (and tell listeners about
+		// whichever of those actually changed, once everything is in its new state)
+		bool sourceCleared = strcmp(state.source, "none") != 0;
+		bool lampModeCleared = strcmp(state.lampMode, "off") != 0;
+		bool muteCleared = state.isMuted, blankCleared = state.isImageBlanked, freezeCleared = state.isImageFrozen;
+		bool volumeCleared = getVolume() != 0;
+
+		state.isOn = false;
+		state.isTransitioning = true;
+		strcpy(state.source, "none");
+		strcpy(state.lampMode, "off");
+		state.isMuted = state.isImageBlanked = state.isImageFrozen = false;
+		state.volume = 0;
+		volumeControl.target = -1;
+		volumeControl.confirming = false;
+
+		// we say powering off here because, at least with my projector, we may see another
+		// 'on' followed by some illegal state messages, then finally an off once it finishes
+		// cooling off
+		state.statusStr = "Powering off...";
+
+		logger.info("Looks like the projector is powering off");
+
+		lastOff = millis();
+		transitions.start(TransitionModel::TRANSITION_COOL_DOWN, lastOff);
+		scheduleEta();
+
+		changed(FIELD_POWER);
+		changed(FIELD_STATUS);
+		changed(FIELD_TRANSITION);
+		if (sourceCleared) changed(FIELD_SOURCE);
+		if (lampModeCleared) changed(FIELD_LAMP_MODE);
+		if (muteCleared) changed(FIELD_MUTE);
+		if (blankCleared) changed(FIELD_BLANK);
+		if (freezeCleared) changed(FIELD_FREEZE);
+		if (volumeCleared) changed(FIELD_VOLUME);
+	} else if (!state.isOn) {
+		if (nextOn && !isCoolingDown()) {
+			// if we see an on once it's done cooling down, obey
+			state.isOn = true;
+			state.isTransitioning = false;
+			state.statusStr = "On";
+
+			logger.info("Looks like the projector has powered on");
+
+			lastOn = millis();
+			transitions.start(TransitionModel::TRANSITION_WARM_UP, lastOn);
+			scheduleEta();
 
-			stringstream log;
-			log << "Took initial power value of " << nextOn << " from projector";
-			logger.debug(log.str());
+			// everything we knew was cleared when it went off
+			polls.pollAllNow(millis());
+			scheduler.at(pollTimer, millis());
 
-			state.isOn = nextOn;
+			changed(FIELD_POWER);
+			changed(FIELD_STATUS);
+			changed(FIELD_TRANSITION);
+		} else if (!nextOn && state.isTransitioning) {
+			// if we see our second off at any point, we can switch the status to 'off'
 			state.isTransitioning = false;
-			state.initialized = true;
-		} else if (state.isOn && !nextOn) {
-			// projector reports off, so clear values back to defaults
-			state.isOn = false;
-			state.isTransitioning = true;
-			strcpy(state.source, "none");
-			strcpy(state.lampMode, "off");
-			state.isMuted = state.isImageBlanked = state.isImageFrozen = false;
-			state.volume = 0;
-			state.targetVolume = -1;
-
-			// we say powering off here because, at least with my projector, we may see another
-			// 'on' followed by some illegal state messages, then finally an off once it finishes
-			// cooling off
-			state.statusStr = "Powering off...";
-
-			logger.info("Looks like the projector is powering off");
+			state.statusStr = "Off";
+
+			logger.info("Looks like the projector has finished powering off after %lums", millis() - lastOff);
+			// (saved along with the status, below)
+			transitions.finish(millis());
+			scheduleEta();
+			changed(FIELD_STATUS);
+			changed(FIELD_TRANSITION);
+		}
+	}
+}
 
-			lastOff = millis();
-		} else if (!state.isOn) {
-			if (nextOn && (millis() - lastOff) > PROJECTOR_POWER_OFF_TIME) {
-				// if we see an on AFTER the power off time interval, obey
-				state.isOn = true;
-				state.isTransitioning = false;
-				state.statusStr = "On";
-
-				logger.info("Looks like the projector has powered on");
-
-				lastOn = millis();
-			} else if (!nextOn && state.isTransitioning) {
-				// if we see our second off at any point, we can switch the status to 'off'
-				state.isTransitioning = false;
-				state.statusStr = "Off";
-
-				logger.info("Looks like the projector has finished powering off");
-			}
+void BenQProjector::receiveVolume(const char *value, size_t valueLen) {
+	if (valueLen == 1 && (value[0] == '+' || value[0] == '-')) {
+		// volume steps are acknowledged with the step rather than the new volume; assume it took
+		// (the query at the end of a run of steps will tell us if it didn't)
+		state.volume = std::max(0, std::min(PROJECTOR_MAX_VOLUME, state.volume + (value[0] == '+' ? 1 : -1)));
+		changed(FIELD_VOLUME);
+		return;
+	}
+
+	if (valueLen == 0 || !isdigit(value[0])) {
+		return;
+	}
+
+	if (state.volume != parseNumber(value, valueLen)) {
+		state.volume = parseNumber(value, valueLen);
+		changed(FIELD_VOLUME);
+	}
+
+	if (volumeControl.confirming) {
+		volumeControl.confirming = false;
+
+		if (state.volume == volumeControl.target) {
+			// we're there! (getVolume() already said so, so there's nothing new to tell)
+			volumeControl.target = -1;
+			stateVersion++;
+			return;
 		}
-	} else if (strcasecmp(key, "sour") == 0) {
-		strcpy(state.source, value);
-	} else if (strcasecmp(key, "mute") == 0) {
-		state.isMuted = strcasecmp(value, "on");
-	} else if (strcasecmp(key, "vol") == 0) {
-		state.volume = atoi(value);
-		checkVolume();
-	} else if (strcasecmp(key, "lampm") == 0) {
-		strcpy(state.lampMode, value);
-	} else if (strcasecmp(key, "blank") == 0) {
-		state.isImageBlanked = strcasecmp(value, "on") == 0;
-	} else if (strcasecmp(key, "freeze") == 0) {
-		state.isImageFrozen = strcasecmp(value, "on") == 0;
-	} else if (strcasecmp(key, "ltim") == 0) {
-		state.lampHours = atoi(value);
-	} else if (strcasecmp(key, "modelname") == 0) {
-		strcpy(state.modelName, value);
+
+		if (state.volume == volumeControl.lastConfirmed) {
+			// a whole run of steps got us nowhere, so the projector won't go any further
+			logger.error("Volume is stuck at %d short of target %d; giving up", state.volume, volumeControl.target);
+
+			volumeControl.target = -1;
+			changed(FIELD_VOLUME);
+			return;
+		}
+
+		volumeControl.lastConfirmed = state.volume;
 	}
+
+	checkVolume();
 }
 
 void BenQProjector::checkVolume() {
-	// we have to adjust one at a time to get to our target volume
-	//TODO: guard against invalid volumes causing us to continually spam vol-/+
-	if (state.targetVolume >= 0) {
-		stringstream log;
-		log << "Volume is " << state.volume << ", target is " << state.targetVolume << ", updating...";
-		logger.debug(log.str());
-
-		if (state.targetVolume > state.volume) {
-			queueValue("vol", "+");
-		} else if (state.targetVolume < state.volume) {
-			queueValue("vol", "-");
-		} else {
-			// we're there!
-			state.targetVolume = -1;
+	// volume can only be stepped one at a time, so queue a run of steps toward the target; only a
+	// few go ahead of the projector at once (so a target that changes mid-way can't send us far past
+	// it), and we don't turn around until the steps going the other way have been answered
+	if (volumeControl.target < 0 || volumeControl.confirming) {
+		return;
+	}
+
+	int predicted = state.volume + volumeControl.pendingSteps;
+
+	while (predicted != volumeControl.target && abs(volumeControl.pendingSteps) < PROJECTOR_VOLUME_STEPS_AHEAD) {
+		bool up = volumeControl.target > predicted;
+
+		if ((volumeControl.pendingSteps > 0 && !up) || (volumeControl.pendingSteps < 0 && up)) {
+			break;
+		}
+
+		if (!sendQueue.push(PRIORITY_INTERACTIVE, up ? "vol=+" : "vol=-")) {
+			break;
 		}
+		wakeSender();
+
+		volumeControl.pendingSteps += up ? 1 : -1;
+		predicted += up ? 1 : -1;
+	}
+
+	if (predicted == volumeControl.target && volumeControl.pendingSteps == 0) {
+		// every step has been answered, so check we really got there
+		volumeControl.confirming = true;
+		queueQuery("vol");
+	}
+}
+
+void BenQProjector::volumeCommandDone(const char *command, CommandResult result) {
+	bool step = strcasecmp(command, "vol=+") == 0 || strcasecmp(command, "vol=-") == 0;
+
+	if (step && volumeControl.pendingSteps != 0) {
+		volumeControl.pendingSteps += volumeControl.pendingSteps > 0 ? -1 : 1;
+		checkVolume();
+	} else if (!step && volumeControl.confirming && strcasecmp(command, "vol=?") == 0 && result != COMMAND_OK) {
+		logger.error("Couldn't confirm volume reached target %d; giving up", volumeControl.target);
+
+		volumeControl.confirming = false;
+		volumeControl.target = -1;
+		changed(FIELD_VOLUME);
 	}
 }
 
 
-void BenQProjector::queueRaw(const char *raw) {
-	char *toQueue = new char[strlen(raw) + 1]; // room for the null termination
-	strcpy(toQueue, raw);
-	sendQueue.push(toQueue);
+void BenQProjector::queueRaw(const char *raw, CommandPriority priority) {
+	// raw commands are sent exactly as asked, so they never get coalesced
+	if (!sendQueue.push(priority, raw)) {
+		logger.error("Dropping command (send queue full or command too long): %s", raw);
+		return;
+	}
+	wakeSender();
 }
 
-void BenQProjector::queueValue(const char *key, const char *value) {
-	char *toQueue = new char[strlen(key) + strlen(value) + 2]; // room for the null termination
-	strcpy(toQueue, key);
-	strcat(toQueue, "=");
-	strcat(toQueue, value);
-	sendQueue.push(toQueue);
+void BenQProjector::queueValue(const char *key, const char *value, CommandPriority priority) {
+	// a newer value for a key replaces one that hasn't been sent yet
+	if (!sendQueue.push(priority, key, value, COALESCE_REPLACE)) {
+		logger.error("Dropping command (send queue full or command too long): %s=%s", key, value);
+		return;
+	}
+	wakeSender();
 }
 
-void BenQProjector::queueQuery(const char *key) {
-	queueValue(key, "?");
+void BenQProjector::queueQuery(const char *key, CommandPriority priority) {
+	// asking for something that's already going to be asked for is pointless
+	if (!sendQueue.push(priority, key, "?", COALESCE_DUPLICATE)) {
+		logger.error("Dropping query (send queue full or key too long): %s", key);
+		return;
+	}
+	wakeSender();
 }
 
-bool BenQProjector::checkForSend() {
+void BenQProjector::wakeSender() {
+	// if it's armed, the sender is already waiting on the projector and will get to this
+	if (!scheduler.isPending(sendTimer)) {
+		scheduler.at(sendTimer, millis());
+	}
+}
+
+void BenQProjector::checkForSend() {
 	// don't flood the projector by sending too much; otherwise messages get dropped and things end
-	// up getting corrupted
+	// up getting corrupted. we hold off until the projector has answered the last command (or we
+	// gave up waiting), and then for the learned gap after that; the send timer goes off at the
+	// end of whichever of those we're in
 	auto now = millis();
-	if (now >= nextSend && !sendQueue.empty()) {
-		// send next from queue
-		const char *toSend = sendQueue.front();
+	if (inFlight.awaitingResponse) {
+		responseTimedOut();
+		return;
+	}
+
+	if (!inFlight.active) {
+		if (sendQueue.empty()) {
+			// nothing to do until something's queued
+			return;
+		}
+
+		// take the next command off the queue; we hang on to it until it's answered
+		strcpy(inFlight.command, sendQueue.front());
+		inFlight.priority = sendQueue.frontPriority();
+		inFlight.attempts = 0;
+		inFlight.active = true;
 		sendQueue.pop();
 
-		out.print("\r*");
-		out.print(toSend);
-		out.print("#\r");
+		if (inFlight.priority != PRIORITY_POLL) {
+			// keep a closer eye on whatever this might change
+			polls.boost(inFlight.command, strcspn(inFlight.command, "="), now);
+			scheduler.at(pollTimer, now);
+		} else if (!scheduler.isPending(pollTimer)) {
+			// polling was waiting for room in the queue
+			scheduler.at(pollTimer, now);
+		}
+	}
+
+	out.print("\r*");
+	out.print(inFlight.command);
+	out.print("#\r");
 
-		logger.commSent(toSend);
-		nextSend = now + PROJECTOR_SEND_INTERVAL;
+	logger.commSent("%s", inFlight.command);
 
-		sendStats.total++;
-		sendStats.current10s++; sendStats.current60s++; sendStats.current360s++;
+	inFlight.attempts++;
+	inFlight.awaitingResponse = true;
+	inFlight.echoed = false;
+	inFlight.sentAt = now;
+	scheduler.at(sendTimer, now + pacing.timeout);
+
+	sendStats.add();
+}
 
-		delete toSend;
-		return true;
+bool BenQProjector::isInFlightKey(const char *key, size_t keyLen) {
+	// replies come back with the key we sent (in upper case), e.g. pow=? is answered with *POW=ON#
+	return strncasecmp(inFlight.command, key, keyLen) == 0 && (inFlight.command[keyLen] == '=' || inFlight.command[keyLen] == 0);
+}
+
+void BenQProjector::responseReceived(CommandResult result) {
+	auto now = millis();
+	float sample = now - inFlight.sentAt;
+	responseLatency.observe(now - inFlight.sentAt);
+
+	// smooth the response time and its variance the same way TCP does for round trip times
+	if (pacing.responseTime == 0) {
+		pacing.responseTime = sample;
+		pacing.responseTimeVar = sample / 2;
+	} else {
+		pacing.responseTimeVar = 0.75f * pacing.responseTimeVar + 0.25f * fabsf(pacing.responseTime - sample);
+		pacing.responseTime = 0.875f * pacing.responseTime + 0.125f * sample;
+	}
+
+	pacing.timeout = std::max(PROJECTOR_MIN_RESPONSE_TIMEOUT, std::min(PROJECTOR_MAX_RESPONSE_TIMEOUT, (int)(pacing.responseTime + 4 * pacing.responseTimeVar + 0.5f)));
+
+	// after a good run of clean responses, try tightening the gap back up; halving it, as doubling
+	// it is how it grew, so that one bad patch doesn't leave us crawling along for ages afterwards
+	if (++pacing.cleanResponses >= 4 && pacing.gap > PROJECTOR_MIN_SEND_GAP) {
+		pacing.gap = std::max(PROJECTOR_MIN_SEND_GAP, pacing.gap / 2);
+		pacing.cleanResponses = 0;
+	}
+
+	scheduler.at(sendTimer, now + pacing.gap);
+	completeInFlight(result);
+}
+
+void BenQProjector::responseTimedOut() {
+	inFlight.awaitingResponse = false;
+	pacing.timeouts++;
+
+	if (!inFlight.echoed) {
+		// not even an echo, so the projector probably never got the command; give it more room
+		pacing.gap = std::min(PROJECTOR_SEND_INTERVAL, pacing.gap * 2);
+		pacing.cleanResponses = 0;
+
+		logger.debug("No echo from projector for %s within %lums; send gap is now %lums", inFlight.command, pacing.timeout, pacing.gap);
+	}
+
+	scheduler.after(sendTimer, pacing.gap);
+
+	// a command that never made it to the projector is always safe to send again; one that was
+	// echoed but not answered may well have been carried out, so only repeat it if it was a query
+	int keyLen = strcspn(inFlight.command, "=");
+	bool isQuery = strcmp(inFlight.command + keyLen, "=?") == 0;
+
+	if ((!inFlight.echoed || isQuery) && inFlight.attempts <= PROJECTOR_COMMAND_RETRIES) {
+		// leave it in flight, and checkForSend will send it again
+		pacing.retries++;
+		return;
+	}
+
+	logger.error("Giving up on %s after %d %s", inFlight.command, inFlight.attempts, inFlight.attempts == 1 ? "attempt" : "attempts");
+
+	completeInFlight(COMMAND_TIMED_OUT);
+}
+
+void BenQProjector::completeInFlight(CommandResult result) {
+	inFlight.active = false;
+	inFlight.awaitingResponse = false;
+
+	if (result != COMMAND_OK) {
+		pacing.failures++;
+
+		int keyLen = strcspn(inFlight.command, "=");
+		unsigned long opensAt;
+		bool watchingTransition = polls.indexOf(inFlight.command, keyLen) == getTransitionProbe() &&
+			(transitions.getWindow(millis(), opensAt) == TransitionModel::BEFORE_WINDOW || transitions.getWindow(millis(), opensAt) == TransitionModel::IN_WINDOW);
+
+		// (updateState has already decided when to next check on a transition)
+		if (inFlight.priority == PRIORITY_POLL && !watchingTransition) {
+			polls.failed(inFlight.command, keyLen, millis());
+			scheduler.at(pollTimer, millis());
+		}
+
+		// only believed once it's fully on, since it may say anything before then; and power is
+		// needed whatever it says
+		int pollIndex = polls.indexOf(inFlight.command, keyLen);
+		if (result == COMMAND_UNSUPPORTED && pollIndex >= 0 && pollIndex != (int)POLL_POWER && !polls.isDisabled(pollIndex) &&
+			state.isOn && transitions.getTransition() != TransitionModel::TRANSITION_WARM_UP) {
+			logger.info("Projector doesn't have %.*s; not polling it any more", keyLen, inFlight.command);
+			polls.setDisabled(pollIndex, true);
+			persist();
+		}
+	}
+
+	if (strncasecmp(inFlight.command, "vol=", 4) == 0) {
+		volumeCommandDone(inFlight.command, result);
+	}
+
+	for (auto it = commandListeners.begin(); it != commandListeners.end(); it++) {
+		(*it)(inFlight.command, inFlight.priority, result);
 	}
-	
-	return false;
 }
 
+void BenQProjector::addCommandListener(std::function<void(const char *, CommandPriority, CommandResult)> listener) {
+	commandListeners.push_back(listener);
+}
 
+void BenQProjector::addChangeListener(std::function<void(const ProjectorChange &)> listener) {
+	changeListeners.push_back(listener);
+}
+
+void BenQProjector::changed(ProjectorField field) {
+	stateVersion++;
+
+	// (every power transition changes the status)
+	if (field == FIELD_MODEL_NAME || field == FIELD_LAMP_HOURS || field == FIELD_STATUS) {
+		persist();
+	}
+
+	if (changeListeners.empty()) {
+		return;
+	}
+
+	ProjectorChange change = { field, false, 0, NULL };
+	switch (field) {
+		case FIELD_POWER: change.on = state.isOn; break;
+		case FIELD_STATUS: change.text = state.statusStr; break;
+		case FIELD_TRANSITION:
+			change.text = getTransition();
+			change.number = getTransitionEta();
+			break;
+		case FIELD_SOURCE: change.text = state.source; break;
+		case FIELD_MUTE: change.on = state.isMuted; break;
+		case FIELD_VOLUME: change.number = getVolume(); break;
+		case FIELD_LAMP_MODE: change.text = state.lampMode; break;
+		case FIELD_LAMP_HOURS: change.number = state.lampHours; break;
+		case FIELD_BLANK: change.on = state.isImageBlanked; break;
+		case FIELD_FREEZE: change.on = state.isImageFrozen; break;
+		case FIELD_MODEL_NAME: change.text = state.modelName; break;
+		case FIELD_3D_MODE: change.text = state.threeDMode; break;
+		case FIELD_PICTURE_MODE: change.text = state.pictureMode; break;
+		case FIELD_COLOR_TEMP: change.text = state.colorTemp; break;
+	}
+
+	for (auto &listener : changeListeners) {
+		listener(change);
+	}
+}
 
 
 bool BenQProjector::isInitialized() {
 	return state.initialized;
 }
 
-void BenQProjector::turnOn() {
-	queueValue("pow", "on");
+void BenQProjector::turnOn(CommandPriority priority) {
+	queueValue("pow", "on", priority);
 }
-void BenQProjector::turnOff() {
-	queueValue("pow", "off");
+void BenQProjector::turnOff(CommandPriority priority) {
+	queueValue("pow", "off", priority);
 }
 bool BenQProjector::isOn() {
 	return state.isOn;
@@ -413,12 +856,25 @@ bool BenQProjector::isMuted() {
 }
 
 void BenQProjector::setVolume(int volume) {
-	state.targetVolume = volume;
+	if (!state.isOn) {
+		logger.info("Can't set volume while the projector is off");
+		return;
+	}
+
+	if (volume < 0 || volume > PROJECTOR_MAX_VOLUME) {
+		logger.error("Volume %d is out of range (0-%d)", volume, PROJECTOR_MAX_VOLUME);
+
+		volume = std::max(0, std::min(PROJECTOR_MAX_VOLUME, volume));
+	}
+
+	volumeControl.target = volume;
+	volumeControl.lastConfirmed = -1;
+	changed(FIELD_VOLUME);
 	checkVolume();
 }
 int BenQProjector::getVolume() {
 	// publicly, report the volume we're working on achieving
-	return state.targetVolume >= 0 ? state.targetVolume : state.volume;
+	return volumeControl.target >= 0 ? volumeControl.target : state.volume;
 }
 
 void BenQProjector::setLampMode(const char *mode) {
@@ -432,8 +888,8 @@ int BenQProjector::getLampHours() {
 	return state.lampHours;
 }
 
-void BenQProjector::setImageBlank(bool blank) {
-	queueValue("blank", blank ? "on" : "off");
+void BenQProjector::setImageBlank(bool blank, CommandPriority priority) {
+	queueValue("blank", blank ? "on" : "off", priority);
 }
 bool BenQProjector::isImageBlanked() {
 	return state.isImageBlanked;
@@ -450,22 +906,196 @@ const char *BenQProjector::getModelName() {
 	return state.modelName;
 }
 
+unsigned long BenQProjector::getStateVersion() {
+	return stateVersion;
+}
+
+const char *BenQProjector::getTransition() {
+	switch (transitions.getTransition()) {
+		case TransitionModel::TRANSITION_WARM_UP: return "warming up";
+		case TransitionModel::TRANSITION_COOL_DOWN: return "cooling down";
+		default: return NULL;
+	}
+}
+
+long BenQProjector::getTransitionEta() {
+	unsigned long remaining;
+	if (!transitions.getRemainingTime(millis(), remaining)) {
+		return -1;
+	}
+
+	// rounded up to a whole step, so it only says 0 once it's overdue
+	return (remaining + PROJECTOR_ETA_STEP - 1) / PROJECTOR_ETA_STEP * PROJECTOR_ETA_STEP;
+}
+
+void BenQProjector::getLearnedTransitions(long &warmUpMs, int &warmUpsSeen, long &coolDownMs, int &coolDownsSeen) {
+	unsigned long expected;
+	warmUpMs = transitions.getExpectedTime(TransitionModel::TRANSITION_WARM_UP, expected) ? expected : -1;
+	warmUpsSeen = transitions.getSamples(TransitionModel::TRANSITION_WARM_UP);
+	coolDownMs = transitions.getExpectedTime(TransitionModel::TRANSITION_COOL_DOWN, expected) ? expected : -1;
+	coolDownsSeen = transitions.getSamples(TransitionModel::TRANSITION_COOL_DOWN);
+}
+
+void BenQProjector::scheduleEta() {
+	// the ETA is rounded up to a step, so it moves on as the time left drops to a whole step
+	unsigned long remaining;
+	if (!transitions.getRemainingTime(millis(), remaining) || remaining == 0) {
+		scheduler.cancel(etaTimer);
+		return;
+	}
+
+	scheduler.after(etaTimer, remaining - (remaining - 1) / PROJECTOR_ETA_STEP * PROJECTOR_ETA_STEP);
+}
+
+bool BenQProjector::isCoolingDown() {
+	if (!state.isTransitioning) {
+		return false;
+	}
+
+	// if we never see it finish, stop waiting eventually
+	unsigned long coolDown;
+	if (!transitions.getExpectedTime(TransitionModel::TRANSITION_COOL_DOWN, coolDown)) {
+		coolDown = PROJECTOR_COOL_DOWN_TIME / 2;
+	}
+	return millis() - lastOff < 2 * coolDown;
+}
+
+int BenQProjector::getTransitionProbe() {
+	// the key whose answer changes when the current transition is over
+	switch (transitions.getTransition()) {
+		case TransitionModel::TRANSITION_WARM_UP: return POLL_WARM_UP_PROBE;
+		case TransitionModel::TRANSITION_COOL_DOWN: return POLL_POWER;
+		default: return -1;
+	}
+}
+
+BenQProjector::Snapshot BenQProjector::getSnapshot() {
+	Snapshot snapshot;
+
+	snapshot.version = stateVersion;
+	snapshot.initialized = state.initialized;
+	snapshot.isOn = state.isOn;
+	snapshot.statusStr = state.statusStr;
+	snapshot.source = state.source;
+	snapshot.isMuted = state.isMuted;
+	snapshot.volume = getVolume();
+	snapshot.lampMode = state.lampMode;
+	snapshot.lampHours = state.lampHours;
+	snapshot.isImageBlanked = state.isImageBlanked;
+	snapshot.isImageFrozen = state.isImageFrozen;
+	snapshot.modelName = state.modelName;
+	snapshot.transition = getTransition();
+	snapshot.transitionEta = getTransitionEta();
+
+	return snapshot;
+}
+
+const char *BenQProjector::getThreeDMode() {
+	return state.threeDMode;
+}
+const char *BenQProjector::getPictureMode() {
+	return state.pictureMode;
+}
+const char *BenQProjector::getColorTemp() {
+	return state.colorTemp;
+}
+
+bool BenQProjector::sendRemoteKey(const char *key, CommandPriority priority) {
+	struct RemoteKey {
+		const char *key;
+		const char *command, *value;
+	};
+
+	static constexpr RemoteKey keys[] = {
+		// info toggles the menu on and off, back closes it
+		{ "INFO", "menu", nullptr },
+		{ "BACK", "menu", "off" },
+		{ "SELECT", "enter", nullptr },
+		{ "UP", "up", nullptr },
+		{ "DOWN", "down", nullptr },
+		{ "LEFT", "left", nullptr },
+		{ "RIGHT", "right", nullptr },
+	};
+	static constexpr KeyTable<RemoteKey, sizeof(keys) / sizeof(keys[0])> table(keys);
+
+	const RemoteKey *remoteKey = table.find(key);
+	if (remoteKey == NULL) {
+		return false;
+	}
+
+	if (remoteKey->value != NULL) {
+		queueValue(remoteKey->command, remoteKey->value, priority);
+	} else {
+		queueRaw(remoteKey->command, priority);
+	}
+
+	return true;
+}
+
 void BenQProjector::getSendStats(long &total, int &count10s, int &count60s, int &count360s, float &rate10s, float &rate60s, float &rate360s) {
-	total = sendStats.total;
-	count10s = sendStats.last10s;
-	count60s = sendStats.last60s;
-	count360s = sendStats.last360s;
-	rate10s = sendStats.last10sRate;
-	rate60s = sendStats.last60sRate;
-	rate360s = sendStats.last360sRate;
+	sendStats.get(total, count10s, count60s, count360s, rate10s, rate60s, rate360s);
 }
 
 void BenQProjector::getRecvStats(long &total, int &count10s, int &count60s, int &count360s, float &rate10s, float &rate60s, float &rate360s) {
-	total = recvStats.total;
-	count10s = recvStats.last10s;
-	count60s = recvStats.last60s;
-	count360s = recvStats.last360s;
-	rate10s = recvStats.last10sRate;
-	rate60s = recvStats.last60sRate;
-	rate360s = recvStats.last360sRate;
+	recvStats.get(total, count10s, count60s, count360s, rate10s, rate60s, rate360s);
+}
+
+void BenQProjector::setRecvBudget(unsigned long budgetMicros) {
+	recvBudget = budgetMicros;
+}
+
+void BenQProjector::getRecvLoopStats(float &framesPerLoop, int &maxFramesPerLoop, long &budgetOverruns) {
+	framesPerLoop = recvLoop.loops > 0 ? (float)recvLoop.frames / recvLoop.loops : 0;
+	maxFramesPerLoop = recvLoop.maxFrames;
+	budgetOverruns = recvLoop.overruns;
+}
+
+void BenQProjector::getCoalesceStats(long &duplicateQueries, long &replacedSetters) {
+	duplicateQueries = sendQueue.getDuplicatesDropped();
+	replacedSetters = sendQueue.getSettersReplaced();
+}
+
+int BenQProjector::getQueueDepth(CommandPriority priority) {
+	return sendQueue.size(priority);
+}
+
+void BenQProjector::getPacingStats(float &responseTime, int &timeout, int &gap, long &timeouts) {
+	responseTime = pacing.responseTime;
+	timeout = pacing.timeout;
+	gap = pacing.gap;
+	timeouts = pacing.timeouts;
 }
+
+void BenQProjector::getCommandStats(long &retries, long &failures) {
+	retries = pacing.retries;
+	failures = pacing.failures;
+}
+
+void BenQProjector::getFrameErrorStats(long &malformed, long &overflowed) {
+	malformed = frameErrors.malformed;
+	overflowed = frameErrors.overflowed;
+}
+
+void BenQProjector::getErrorReplyStats(long &illegalFormat, long &blocked, long &unsupported) {
+	illegalFormat = errorReplies.illegalFormat;
+	blocked = errorReplies.blocked;
+	unsupported = errorReplies.unsupported;
+}
+
+const Histogram<10> &BenQProjector::getResponseLatency() {
+	return responseLatency;
+}
+
+bool BenQProjector::getValueAge(size_t index, const char *&key, long &ageMs) {
+	for (size_t i = 0; i < VALUE_KEYS; ++i) {
+		if (valueSeen[i].key == NULL) {
+			continue;
+		}
+		if (index-- == 0) {
+			key = valueSeen[i].key;
+			ageMs = millis() - valueSeen[i].at;
+			return true;
+		}
+	}
+	return false;
+}
\ No newline at end of file
@@ -1,21 +1,114 @@
 #ifndef PROJECTOR_HPP
 #define PROJECTOR_HPP
 
-// default buffer size of 64 bytes
-#define PROJECTOR_RECV_BUFFER_SIZE 64
-
-// default send interval of 100ms
+// default send interval of 100ms; this is where response-driven pacing starts out (as the response
+// timeout) and the most it will ever back off to between commands
 #define PROJECTOR_SEND_INTERVAL 100
 
-// default poweroff dead time of 2 minutes
-#define PROJECTOR_POWER_OFF_TIME 120000
+// default minimum gap of 2ms between a response and the next command
+#define PROJECTOR_MIN_SEND_GAP 2
+
+// default bounds for the learned response timeout, 50ms - 1s
+#define PROJECTOR_MIN_RESPONSE_TIMEOUT 50
+#define PROJECTOR_MAX_RESPONSE_TIMEOUT 1000
+
+// default of 2 retries for a command that gets lost
+#define PROJECTOR_COMMAND_RETRIES 2
+
+// default receive budget of 2ms per loop; frames that are still waiting once it's used up are
+// handled on the next loop
+#define PROJECTOR_RECV_BUDGET 2000
+
+// default volume range of 0 - 20
+#define PROJECTOR_MAX_VOLUME 20
+
+// default of up to 4 volume steps queued ahead of the projector; it takes them one at a time
+// anyway, so more wouldn't be faster, just more to overshoot by if the target changes mid-way
+#define PROJECTOR_VOLUME_STEPS_AHEAD 4
 
+// default of polling what the projector only reports while it's on every minute, lamp mode every 10
+// minutes and lamp hours every hour; power is polled at the interval given to the constructor
+#define PROJECTOR_POLL_STATUS_INTERVAL 60000
+#define PROJECTOR_POLL_LAMP_MODE_INTERVAL 600000
+#define PROJECTOR_POLL_LAMP_HOURS_INTERVAL 3600000
+
+// default of polling every 500ms for the end of a warm-up or cool-down, around when we've learned to
+// expect it
+#define PROJECTOR_TRANSITION_POLL_INTERVAL 500
+
+// default of assuming a cool-down takes up to 2 minutes until we've seen one; the projector may say
+// it's on again while cooling down, which is ignored until then (or twice the learned time)
+#define PROJECTOR_COOL_DOWN_TIME 120000
+
+// default of the ETA for a warm-up or cool-down moving in 5 second steps, each a change of state
+#define PROJECTOR_ETA_STEP 5000
+
+#include "command_queue.hpp"
+#include "frame_parser.hpp"
+#include "histogram.hpp"
 #include "logger.hpp"
+#include "poll_scheduler.hpp"
+#include "scheduler.hpp"
+#include "sliding_counter.hpp"
+#include "state_store.hpp"
+#include "transition_model.hpp"
 
-#include <queue>
+#include <functional>
+#include <list>
 
 #include <HardwareSerial.h>
 
+/**
+ * How the projector answered a command we sent.
+ */
+enum CommandResult {
+	// answered with a value for the key we sent
+	COMMAND_OK,
+	// *Block item#; can't do that in the projector's current state (e.g. still warming up)
+	COMMAND_BLOCKED,
+	// *Unsupported item#
+	COMMAND_UNSUPPORTED,
+	// *Illegal format#
+	COMMAND_ILLEGAL_FORMAT,
+	// never answered, even after retrying
+	COMMAND_TIMED_OUT,
+};
+
+/**
+ * The parts of the projector's state that change listeners are told about.
+ */
+enum ProjectorField {
+	// on or off (including the first value we get, which is when isInitialized() turns true)
+	FIELD_POWER,
+	// getStatusStr()
+	FIELD_STATUS,
+	// getTransition() and getTransitionEta(), including each step of the ETA
+	FIELD_TRANSITION,
+	FIELD_SOURCE,
+	FIELD_MUTE,
+	// the volume we're working on achieving, like getVolume()
+	FIELD_VOLUME,
+	FIELD_LAMP_MODE,
+	FIELD_LAMP_HOURS,
+	FIELD_BLANK,
+	FIELD_FREEZE,
+	FIELD_MODEL_NAME,
+	FIELD_3D_MODE,
+	FIELD_PICTURE_MODE,
+	FIELD_COLOR_TEMP,
+};
+
+/**
+ * One field's new value, as handed to change listeners: whichever of on, number and text the
+ * field has (the text is only good until the listener returns).
+ */
+struct ProjectorChange {
+	ProjectorField field;
+	bool on;
+	long number;
+	const char *text;
+};
+
 /**
  * Helper for handling RS232 communication with the projector.
  */
@@ -32,20 +125,34 @@ public:
 	 * This implementation assumes that the serial ports will have been configured as necessary
 	 * (with the correct baud rate, etc) and are ready for communicating with the projector when
 	 * begin() is called.
+	 *
+	 * Sending, polling and the ETA of a warm-up or cool-down run off timers on the scheduler;
+	 * loop() only reads what the projector sends.
+	 *
+	 * What's slow to find out again (the model name, lamp hours, how long warm-ups and cool-downs
+	 * take, which keys the projector doesn't have, and the last power transition) is kept in the
+	 * state store, and restored by begin() before anything is polled.
 	 **/
-	BenQProjector(Logger &logger, HardwareSerial &in, HardwareSerial &out, int pollIntervalSecs);
+	BenQProjector(Logger &logger, Scheduler &scheduler, StateStore &store, HardwareSerial &in, HardwareSerial &out, int pollIntervalSecs);
 
 	void begin();
 	void loop();
 
-	void queueRaw(const char *raw);
-	void queueValue(const char *key, const char *value);
-	void queueQuery(const char *key);
+	// commands are interactive (i.e., from a user) unless said otherwise
+	void queueRaw(const char *raw, CommandPriority priority = PRIORITY_INTERACTIVE);
+	void queueValue(const char *key, const char *value, CommandPriority priority = PRIORITY_INTERACTIVE);
+	void queueQuery(const char *key, CommandPriority priority = PRIORITY_INTERACTIVE);
+
+	// called once for every command that is sent, with how the projector answered it
+	void addCommandListener(std::function<void(const char *command, CommandPriority priority, CommandResult result)> listener);
+	// called as soon as any field changes (straight from the frame that changed it), once per
+	// field; the state version has already moved on, and every getter already has the new value
+	void addChangeListener(std::function<void(const ProjectorChange &change)> listener);
 
 	bool isInitialized();
 
-	void turnOn();
-	void turnOff();
+	void turnOn(CommandPriority priority = PRIORITY_INTERACTIVE);
+	void turnOff(CommandPriority priority = PRIORITY_INTERACTIVE);
 	bool isOn();
 	long getLastOnTime();
 	long getLastOffTime();
@@ -67,7 +174,7 @@ public:
 
 	int getLampHours();
 	
-	void setImageBlank(bool blank);
+	void setImageBlank(bool blank, CommandPriority priority = PRIORITY_INTERACTIVE);
 	bool isImageBlanked();
 
 	void setImageFreeze(bool freeze);
@@ -75,63 +182,225 @@ public:
 
 	const char *getModelName();
 
+	const char *getThreeDMode();
+	const char *getPictureMode();
+	const char *getColorTemp();
+
+	// "warming up" or "cooling down" (NULL otherwise), and about how long (in ms) until that's
+	// done, or -1 if we don't know yet
+	const char *getTransition();
+	long getTransitionEta();
+	// how long warming up and cooling down take, as learned; -1 until one has been seen
+	void getLearnedTransitions(long &warmUpMs, int &warmUpsSeen, long &coolDownMs, int &coolDownsSeen);
+
+	/**
+	 * Everything we know about the projector at one point in time. The version goes up every time
+	 * any of it changes, so it can be used to tell whether anything derived from an earlier
+	 * snapshot is stale. The strings point into our state, and are only good until the next loop.
+	 */
+	struct Snapshot {
+		unsigned long version;
+		bool initialized;
+		bool isOn;
+		const char *statusStr;
+		const char *source;
+		bool isMuted;
+		// the volume we're working on achieving, like getVolume()
+		int volume;
+		const char *lampMode;
+		int lampHours;
+		bool isImageBlanked, isImageFrozen;
+		const char *modelName;
+		// as getTransition() and getTransitionEta()
+		const char *transition;
+		long transitionEta;
+	};
+
+	unsigned long getStateVersion();
+	Snapshot getSnapshot();
+
+	// press a key on the projector's remote (INFO, BACK, SELECT, UP, DOWN, LEFT or RIGHT); returns
+	// false for keys we don't know
+	bool sendRemoteKey(const char *key, CommandPriority priority = PRIORITY_INTERACTIVE);
+
+	// how long (in microseconds) each loop may spend handling received frames
+	void setRecvBudget(unsigned long budgetMicros);
+
 	void getSendStats(long &total, int &count10s, int &count60s, int &count360s, float &rate10s, float &rate60s, float &rate360s);
 	void getRecvStats(long &total, int &count10s, int &count60s, int &count360s, float &rate10s, float &rate60s, float &rate360s);
+	// of the loops that handled any frames, how many they handled, and how often the budget ran out
+	void getRecvLoopStats(float &framesPerLoop, int &maxFramesPerLoop, long &budgetOverruns);
+	void getCoalesceStats(long &duplicateQueries, long &replacedSetters);
+	void getPacingStats(float &responseTime, int &timeout, int &gap, long &timeouts);
+	void getCommandStats(long &retries, long &failures);
+	int getQueueDepth(CommandPriority priority);
+	// lines that weren't frames, and ones too long for the receive buffer
+	void getFrameErrorStats(long &malformed, long &overflowed);
+	void getErrorReplyStats(long &illegalFormat, long &blocked, long &unsupported);
+	// milliseconds from sending a command to its answer
+	const Histogram<10> &getResponseLatency();
+	// how long ago (in ms) each key's value was last received, for index 0 and up until it returns
+	// false; keys that haven't been received yet are skipped
+	bool getValueAge(size_t index, const char *&key, long &ageMs);
 
 private:
 
 	Logger &logger;
+	Scheduler &scheduler;
+	StateStore &store;
 	HardwareSerial &in, &out;
-	std::queue<const char *> sendQueue;
-	long nextSend;
+	CommandQueue sendQueue;
+	// when the next command can go out, or the one in flight has gone unanswered for too long
+	int sendTimer;
 	int pollInterval;
-	long nextUpdate;
+	PollScheduler<9> polls;
+	// when the next key is due to be polled; not armed while the queue is too full for more
+	int pollTimer;
+	TransitionModel transitions;
+	// when the ETA of a warm-up or cool-down next moves on a step
+	int etaTimer;
 	int maxQueueSizeForPoll;
 	long lastOn, lastOff;
 
 	// just for fun, keep stats of message throughput
+	TrafficCounter sendStats, recvStats;
+
+	unsigned long recvBudget;
+	unsigned long stateVersion;
+	struct {
+		long loops = 0, frames = 0;
+		int maxFrames = 0;
+		long overruns = 0;
+	} recvLoop;
 	struct {
-		long total = 0;
-		int current10s = 0, last10s = 0;
-		int current60s = 0, last60s = 0;
-		int current360s = 0, last360s = 0;
-		float last10sRate = 0, last60sRate = 0, last360sRate = 0;
-	} sendStats;
+		long malformed = 0, overflowed = 0;
+	} frameErrors;
+	struct {
+		long illegalFormat = 0, blocked = 0, unsupported = 0;
+	} errorReplies;
+	Histogram<10> responseLatency;
+
+	std::list<std::function<void(const char *, CommandPriority, CommandResult)>> commandListeners;
+	std::list<std::function<void(const ProjectorChange &)>> changeListeners;
+
+	// the command we've sent (or are about to resend) and are waiting on the projector to answer;
+	// the projector echoes it back first, then answers with a value for the same key or an error
 	struct {
-		long total = 0;
-		int current10s = 0, last10s = 0;
-		int current60s = 0, last60s = 0;
-		int current360s = 0, last360s = 0;
-		float last10sRate = 0, last60sRate = 0, last360sRate = 0;
-	} recvStats;
-	long last10s, last60s, last360s;
+		bool active = false;
+		bool awaitingResponse = false, echoed = false;
+		char command[PROJECTOR_COMMAND_SIZE];
+		CommandPriority priority = PRIORITY_POLL;
+		int attempts = 0;
+		long sentAt = 0;
+	} inFlight;
 
+	// response-driven send pacing: rather than a fixed gap between commands, send the next one as
+	// soon as the projector has echoed and answered the last one. The response timeout tracks the
+	// response times we see (smoothed, TCP-style), and the gap after a response backs off whenever
+	// a command goes unechoed (i.e., it was probably dropped by an overrun projector)
 	struct {
+		float responseTime = 0, responseTimeVar = 0;
+		int timeout = PROJECTOR_SEND_INTERVAL;
+		int gap = PROJECTOR_MIN_SEND_GAP;
+		int cleanResponses = 0;
+		long timeouts = 0, retries = 0, failures = 0;
+	} pacing;
+
+	struct State {
 		bool initialized = false;
 		bool isOn = false, isTransitioning = false;
 		char *statusStr = "off";
 		char source[16] = "none";
 		bool isMuted = false;
-		int volume = 0, targetVolume = -1;
+		int volume = 0;
 		char lampMode[8] = "off";
 		int lampHours = 0;
 		bool isImageBlanked = false;
 		bool isImageFrozen = false;
 		char modelName[32] = "";
+		char threeDMode[16] = "";
+		char pictureMode[16] = "";
+		char colorTemp[16] = "";
 	} state;
 
+	// what's kept in the state store across reboots
+	struct Persisted {
+		char modelName[32];
+		int32_t lampHours;
+		TransitionModel::Learned learned;
+		// the poll keys the projector answered "Unsupported item" to, a bit each
+		uint16_t unsupportedPolls;
+		// the last power transition seen (PERSISTED_OFF, _ON or _COOLING_DOWN)
+		uint8_t power;
+	};
+
+	static_assert(sizeof(Persisted) <= STATE_STORE_RECORD_SIZE, "Persisted must fit in the state store");
+
+	// setVolume steps toward the target a run at a time, then queries to confirm where we ended up
 	struct {
-		char data[PROJECTOR_RECV_BUFFER_SIZE];
-		int idx = 0;
-		bool overflow = false;
-	} recvBuffer;
+		int target = -1;
+		// steps queued but not yet answered; positive for up, negative for down
+		int pendingSteps = 0;
+		bool confirming = false;
+		// what the last confirming query said, to spot a run of steps that got us nowhere
+		int lastConfirmed = -1;
+	} volumeControl;
+
+	// how receiveValue stores a value reported for a key
+	enum ValueKind {
+		// copied into a char array field of state
+		VALUE_STRING,
+		// ON/OFF into a bool field of state
+		VALUE_ON_OFF,
+		// into an int field of state
+		VALUE_NUMBER,
+		// handed to a member function
+		VALUE_CUSTOM,
+	};
+
+	struct ValueHandler {
+		const char *key;
+		ValueKind kind;
+		// what listeners are told changed (custom handlers tell them themselves)
+		ProjectorField field;
+		size_t offset, size;
+		void (BenQProjector::*receive)(const char *value, size_t valueLen);
+	};
+
+	// how many keys receiveValue handles, and when each was last received
+	static constexpr size_t VALUE_KEYS = 12;
+	struct {
+		const char *key = NULL;
+		long at = 0;
+	} valueSeen[VALUE_KEYS];
+
+	FrameParser recvParser;
 
 	void updateState();
-	void receiveValue(const char *key, const char *value);
+	void changed(ProjectorField field);
+	void restore();
+	void persist();
+	void receiveFrame(const Frame &frame);
+	void receiveMessage(const Frame &frame);
+	void receiveValue(const char *key, size_t keyLen, const char *value, size_t valueLen);
+	void receivePower(const char *value, size_t valueLen);
+	void receiveVolume(const char *value, size_t valueLen);
 	void checkVolume();
+	void volumeCommandDone(const char *command, CommandResult result);
+
+	void checkForSend();
+	void wakeSender();
+	int checkForRecv();
+	void pollDue();
+	void scheduleEta();
+
+	bool isCoolingDown();
+	int getTransitionProbe();
 
-	bool checkForSend();
-	bool checkForRecv();
+	bool isInFlightKey(const char *key, size_t keyLen);
+	void responseReceived(CommandResult result);
+	void responseTimedOut();
+	void completeInFlight(CommandResult result);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,182 @@
+#include "scheduler.hpp"
+
+#include <Arduino.h>
+
+// the slot a time falls in; 2^32 is a whole number of turns of the wheel, so this carries on
+// smoothly across millis() wrapping
+static inline int slotOf(uint32_t time) {
+	return (time / SCHEDULER_TICK) % SCHEDULER_SLOTS;
+}
+
+Scheduler::Scheduler() : timerCount(0), lastTick(millis() / SCHEDULER_TICK * SCHEDULER_TICK), fired(0) {
+	for (auto &slot : slots) {
+		slot = -1;
+	}
+}
+
+int Scheduler::add(const char *name, std::function<void()> callback) {
+	if (timerCount == SCHEDULER_TIMERS) {
+		return -1;
+	}
+
+	Timer &timer = timers[timerCount];
+	timer.name = name;
+	timer.callback = callback;
+	timer.when = 0;
+	timer.state = IDLE;
+	timer.slot = timer.next = timer.prev = -1;
+	return timerCount++;
+}
+
+void Scheduler::at(int timer, unsigned long when) {
+	if (timer < 0 || timer >= timerCount) {
+		return;
+	}
+
+	if (timers[timer].state == PENDING) {
+		unlink(timer);
+	}
+
+	timers[timer].when = when;
+	timers[timer].state = PENDING;
+	link(timer);
+}
+
+void Scheduler::after(int timer, unsigned long delayMs) {
+	at(timer, millis() + delayMs);
+}
+
+void Scheduler::cancel(int timer) {
+	if (timer < 0 || timer >= timerCount) {
+		return;
+	}
+
+	if (timers[timer].state == PENDING) {
+		unlink(timer);
+	}
+	timers[timer].state = IDLE;
+}
+
+bool Scheduler::isPending(int timer) {
+	return timer >= 0 && timer < timerCount && timers[timer].state == PENDING;
+}
+
+long Scheduler::getRemaining(int timer) {
+	if (!isPending(timer)) {
+		return -1;
+	}
+
+	int32_t remaining = timers[timer].when - (uint32_t)millis();
+	return remaining > 0 ? remaining : 0;
+}
+
+void Scheduler::loop() {
+	uint32_t now = millis();
+
+	// every slot the clock has moved through since last time, and the one it's in now; after a
+	// long enough gap, that's the whole wheel
+	uint32_t steps = (now - lastTick) / SCHEDULER_TICK;
+	if (steps >= SCHEDULER_SLOTS) {
+		steps = SCHEDULER_SLOTS - 1;
+	}
+
+	int due[SCHEDULER_TIMERS];
+	int dueCount = 0;
+
+	for (uint32_t step = 0; step <= steps; ++step) {
+		int timer = slots[slotOf(lastTick + step * SCHEDULER_TICK)];
+		while (timer >= 0) {
+			int next = timers[timer].next;
+			if ((int32_t)(now - timers[timer].when) >= 0) {
+				unlink(timer);
+				timers[timer].state = FIRING;
+
+				// in the order they were due
+				int at = dueCount++;
+				while (at > 0 && (int32_t)(timers[due[at - 1]].when - timers[timer].when) > 0) {
+					due[at] = due[at - 1];
+					at--;
+				}
+				due[at] = timer;
+			}
+			timer = next;
+		}
+	}
+
+	lastTick = now / SCHEDULER_TICK * SCHEDULER_TICK;
+
+	for (int i = 0; i < dueCount; ++i) {
+		Timer &timer = timers[due[i]];
+		// (an earlier callback may have re-armed or cancelled it)
+		if (timer.state != FIRING) {
+			continue;
+		}
+
+		timer.state = IDLE;
+		fired++;
+		timer.callback();
+	}
+}
+
+bool Scheduler::getNextWake(unsigned long &at) {
+	uint32_t now = millis();
+	uint32_t soonest = 0;
+	bool found = false;
+
+	for (int i = 0; i < timerCount; ++i) {
+		if (timers[i].state == PENDING && (!found || (int32_t)(timers[i].when - soonest) < 0)) {
+			soonest = timers[i].when;
+			found = true;
+		}
+	}
+
+	if (!found) {
+		return false;
+	}
+
+	// overdue is the same as due now, as far as anyone waiting is concerned
+	at = (int32_t)(soonest - now) < 0 ? now : soonest;
+	return true;
+}
+
+unsigned long Scheduler::getIdleTime() {
+	unsigned long wake;
+	if (!getNextWake(wake)) {
+		return SCHEDULER_MAX_IDLE;
+	}
+
+	uint32_t remaining = wake - millis();
+	return remaining < SCHEDULER_MAX_IDLE ? remaining : SCHEDULER_MAX_IDLE;
+}
+
+long Scheduler::getFiredCount() {
+	return fired;
+}
+
+void Scheduler::link(int timer) {
+	// anything due before the tick loop() looks at next goes in that tick's slot, so it isn't
+	// missed until the wheel comes round again
+	uint32_t when = timers[timer].when;
+	int slot = (int32_t)(when - lastTick) < 0 ? slotOf(lastTick) : slotOf(when);
+
+	timers[timer].slot = slot;
+	timers[timer].prev = -1;
+	timers[timer].next = slots[slot];
+	if (slots[slot] >= 0) {
+		timers[slots[slot]].prev = timer;
+	}
+	slots[slot] = timer;
+}
+
+void Scheduler::unlink(int timer) {
+	Timer &t = timers[timer];
+	if (t.prev >= 0) {
+		timers[t.prev].next = t.next;
+	} else {
+		slots[t.slot] = t.next;
+	}
+	if (t.next >= 0) {
+		timers[t.next].prev = t.prev;
+	}
+	t.slot = t.next = t.prev = -1;
+}
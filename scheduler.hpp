@@ -0,0 +1,96 @@
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+// default of room for 12 timers across all subsystems
+#define SCHEDULER_TIMERS 12
+
+// default of a wheel of 32 slots of 8ms each, so it turns once every 256ms; both must be powers of
+// two, so the wheel carries on turning smoothly when millis() wraps
+#define SCHEDULER_SLOTS 32
+#define SCHEDULER_TICK 8
+
+// default of idling for at most 1ms at a time when nothing is due; serial and network input are
+// only noticed when they're polled, so the main loop can't go quiet for long
+#define SCHEDULER_MAX_IDLE 1
+
+#include <functional>
+
+#include <stdint.h>
+
+/**
+ * Deadlines for every subsystem, on a timer wheel. Each subsystem adds the timers it needs once,
+ * then arms them for a time (or cancels them) as often as it likes; loop() runs the callback of
+ * every timer that's come due, and nothing else.
+ *
+ *     int offTimer = scheduler.add("power off", [this]() { turnOff(); });
+ *     scheduler.after(offTimer, 60000);
+ *     ...
+ *     scheduler.loop();
+ *
+ * A timer sits in the slot for the tick it's due in, and each loop only looks at the slots the
+ * clock has moved through since the last one; a timer due more than a turn of the wheel away is
+ * passed over (one comparison) each time round until then. Callbacks still run to the millisecond,
+ * since the slot for the current tick is looked at on every loop.
+ *
+ * Times are kept as 32 bits, as millis() is on the ESP8266, and compared as differences, so they
+ * hold across millis() wrapping (on any platform) for deadlines up to about 24 days away.
+ */
+class Scheduler {
+public:
+
+	Scheduler();
+
+	// returns the timer to pass to the rest, or -1 if there's no room for another; it doesn't go
+	// off until it's armed
+	int add(const char *name, std::function<void()> callback);
+
+	// arms the timer (again) for the given time, which may already have passed; a callback can
+	// re-arm its own timer
+	void at(int timer, unsigned long when);
+	void after(int timer, unsigned long delayMs);
+	void cancel(int timer);
+
+	bool isPending(int timer);
+	// how long until the timer goes off (0 if it's due), or -1 if it isn't armed
+	long getRemaining(int timer);
+
+	// runs whatever's due
+	void loop();
+
+	// when the next timer goes off (which may already have passed), if any are armed
+	bool getNextWake(unsigned long &at);
+	// how long the main loop can idle before anything is due, up to SCHEDULER_MAX_IDLE
+	unsigned long getIdleTime();
+
+	// callbacks run since boot
+	long getFiredCount();
+
+private:
+
+	static_assert((SCHEDULER_SLOTS & (SCHEDULER_SLOTS - 1)) == 0, "SCHEDULER_SLOTS must be a power of two");
+	static_assert((SCHEDULER_TICK & (SCHEDULER_TICK - 1)) == 0, "SCHEDULER_TICK must be a power of two");
+
+	enum State { IDLE, PENDING, FIRING };
+
+	struct Timer {
+		const char *name;
+		std::function<void()> callback;
+		uint32_t when;
+		State state;
+		// the slot it's in, and the other timers in the same slot
+		int slot, next, prev;
+	} timers[SCHEDULER_TIMERS];
+	int timerCount;
+
+	// the first timer in each slot, or -1
+	int slots[SCHEDULER_SLOTS];
+	// the start of the tick that loop() last looked at
+	uint32_t lastTick;
+
+	long fired;
+
+	void link(int timer);
+	void unlink(int timer);
+};
+
+#endif
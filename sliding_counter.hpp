@@ -0,0 +1,114 @@
+#ifndef SLIDING_COUNTER_HPP
+#define SLIDING_COUNTER_HPP
+
+#include <stddef.h>
+
+#include <Arduino.h>
+
+/**
+ * A count of events over the last `windowMs`, kept in N buckets that each cover windowMs / N.
+ * The oldest bucket is dropped as time moves into a new one, so the window slides along a bucket
+ * at a time rather than starting again from zero. Adding is O(1): moving on to the current bucket
+ * clears at most the N in between, and only once per bucket width.
+ *
+ * The count covers between (N - 1) / N of the window and all of it; the rate is worked out over
+ * however much time that actually is (or the time since the counter was created, if that's less).
+ */
+template<size_t N> class SlidingCounter {
+public:
+
+	explicit SlidingCounter(unsigned long windowMs) :
+		width(windowMs / N), buckets(), current(0), currentStart(millis()), created(currentStart), sum(0) {
+	}
+
+	void add(unsigned long count = 1) {
+		advance();
+		buckets[current] += count;
+		sum += count;
+	}
+
+	unsigned long getCount() {
+		advance();
+		return sum;
+	}
+
+	// per second
+	float getRate() {
+		advance();
+
+		unsigned long now = millis();
+		unsigned long covered = (N - 1) * width + (now - currentStart);
+		if (now - created < covered) {
+			covered = now - created;
+		}
+		return covered > 0 ? 1000.0f * sum / covered : 0;
+	}
+
+private:
+
+	const unsigned long width;
+	unsigned long buckets[N];
+	size_t current;
+	unsigned long currentStart, created;
+	unsigned long sum;
+
+	void advance() {
+		// (unsigned, so this holds across millis() wrapping)
+		unsigned long elapsed = millis() - currentStart;
+		if (elapsed < width) {
+			return;
+		}
+
+		unsigned long steps = elapsed / width;
+		currentStart += steps * width;
+
+		if (steps >= N) {
+			// it's been quiet for the whole window
+			for (size_t i = 0; i < N; ++i) {
+				buckets[i] = 0;
+			}
+			sum = 0;
+			return;
+		}
+
+		while (steps-- > 0) {
+			current = (current + 1) % N;
+			sum -= buckets[current];
+			buckets[current] = 0;
+		}
+	}
+};
+
+/**
+ * A running total, plus counts and rates over the last 10 seconds, minute and 6 minutes; the
+ * windows /stats shows.
+ */
+class TrafficCounter {
+public:
+
+	void add() {
+		total++;
+		last10s.add();
+		last60s.add();
+		last360s.add();
+	}
+
+	void get(long &total, int &count10s, int &count60s, int &count360s, float &rate10s, float &rate60s, float &rate360s) {
+		total = this->total;
+		count10s = last10s.getCount();
+		count60s = last60s.getCount();
+		count360s = last360s.getCount();
+		rate10s = last10s.getRate();
+		rate60s = last60s.getRate();
+		rate360s = last360s.getRate();
+	}
+
+private:
+
+	long total = 0;
+	SlidingCounter<10> last10s{10000};
+	SlidingCounter<10> last60s{60000};
+	SlidingCounter<12> last360s{360000};
+};
+
+#endif
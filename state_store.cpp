@@ -0,0 +1,154 @@
+#include "state_store.hpp"
+
+#include <stddef.h>
+#include <string.h>
+
+#include <Arduino.h>
+
+#include "utils.hpp"
+
+StateStore::StateStore(Logger &logger, Scheduler &scheduler, uint32_t firstSector, int sectorCount) :
+	logger(logger), scheduler(scheduler), firstSector(firstSector), sectorCount(sectorCount),
+	usable(sectorCount >= 2), stored(), haveStored(false), nextSlot(0), pending(),
+	writeTimer(scheduler.add("state store write", [this]() { write(); })),
+	writes(0), erases(0) {
+}
+
+bool StateStore::load(uint16_t version, void *data, size_t size) {
+	memset(data, 0, size);
+
+	if (!usable) {
+		logger.error("State store needs at least 2 flash sectors; nothing will be kept across reboots");
+		return false;
+	}
+
+	// the newest slot that holds up, whatever its version, since the next write goes after it
+	int newest = -1;
+	Slot slot;
+	for (int i = 0; i < getSlotCount(); ++i) {
+		ESP.flashRead(getSlotAddress(i), (uint32_t *)&slot, sizeof(slot));
+		if (slot.magic != SLOT_MAGIC || slot.length > STATE_STORE_RECORD_SIZE || slot.crc != crc32Checksum(&slot, offsetof(Slot, crc))) {
+			continue;
+		}
+
+		if (newest < 0 || (int32_t)(slot.sequence - stored.sequence) > 0) {
+			stored = slot;
+			newest = i;
+		}
+	}
+
+	haveStored = newest >= 0;
+	nextSlot = haveStored ? (newest + 1) % getSlotCount() : 0;
+
+	if (!haveStored) {
+		return false;
+	}
+
+	if (stored.version != version) {
+		logger.info("Saved state is from another version of the firmware (%d); starting afresh", stored.version);
+		return false;
+	}
+
+	memcpy(data, stored.data, stored.length < size ? stored.length : size);
+	return true;
+}
+
+void StateStore::save(uint16_t version, const void *data, size_t size) {
+	if (!usable || size > STATE_STORE_RECORD_SIZE) {
+		return;
+	}
+
+	pending.version = version;
+	pending.length = size;
+	memset(pending.data, 0, sizeof(pending.data));
+	memcpy(pending.data, data, size);
+
+	if (haveStored && stored.version == version && stored.length == size && memcmp(stored.data, pending.data, sizeof(pending.data)) == 0) {
+		// (back to) what's in flash already
+		scheduler.cancel(writeTimer);
+		return;
+	}
+
+	// the clock starts at the first change, so a steady trickle of them still gets written
+	if (!scheduler.isPending(writeTimer)) {
+		scheduler.after(writeTimer, STATE_STORE_WRITE_DELAY);
+	}
+}
+
+void StateStore::flush() {
+	if (scheduler.isPending(writeTimer)) {
+		scheduler.cancel(writeTimer);
+		write();
+	}
+}
+
+void StateStore::write() {
+	int perSector = SPI_FLASH_SEC_SIZE / sizeof(Slot);
+
+	pending.magic = SLOT_MAGIC;
+	pending.sequence = haveStored ? stored.sequence + 1 : 0;
+	pending.crc = crc32Checksum(&pending, offsetof(Slot, crc));
+
+	// a slot that isn't free (e.g. it was half written when we lost power) is passed over, as is one
+	// that doesn't read back right
+	for (int tries = 0; tries < getSlotCount(); ++tries) {
+		int slot = nextSlot;
+		nextSlot = (nextSlot + 1) % getSlotCount();
+
+		if (slot % perSector == 0) {
+			// on to the next sector, which has the oldest records in it
+			ESP.flashEraseSector(firstSector + slot / perSector);
+			erases++;
+		} else if (!isFree(slot)) {
+			continue;
+		}
+
+		Slot check;
+		ESP.flashWrite(getSlotAddress(slot), (uint32_t *)&pending, sizeof(pending));
+		ESP.flashRead(getSlotAddress(slot), (uint32_t *)&check, sizeof(check));
+		if (memcmp(&check, &pending, sizeof(check)) != 0) {
+			logger.error("State record didn't read back from flash slot %d; trying the next one", slot);
+			continue;
+		}
+
+		stored = pending;
+		haveStored = true;
+		writes++;
+		return;
+	}
+
+	logger.error("Couldn't write the state record to flash");
+}
+
+int StateStore::getSlotCount() {
+	return sectorCount * (SPI_FLASH_SEC_SIZE / sizeof(Slot));
+}
+
+uint32_t StateStore::getSlotAddress(int slot) {
+	int perSector = SPI_FLASH_SEC_SIZE / sizeof(Slot);
+	return (firstSector + slot / perSector) * SPI_FLASH_SEC_SIZE + slot % perSector * sizeof(Slot);
+}
+
+bool StateStore::isFree(int slot) {
+	// erased flash reads as all ones
+	uint32_t words[sizeof(Slot) / 4];
+	ESP.flashRead(getSlotAddress(slot), words, sizeof(words));
+	for (uint32_t word : words) {
+		if (word != 0xFFFFFFFF) {
+			return false;
+		}
+	}
+	return true;
+}
+
+int StateStore::getSectorCount() {
+	return usable ? sectorCount : 0;
+}
+
+long StateStore::getWrites() {
+	return writes;
+}
+
+long StateStore::getErases() {
+	return erases;
+}
@@ -0,0 +1,91 @@
+#ifndef STATE_STORE_HPP
+#define STATE_STORE_HPP
+
+// default of room for a record of up to 128 bytes
+#define STATE_STORE_RECORD_SIZE 128
+
+// default of taking turns over 4 sectors (16KB) of flash
+#define STATE_STORE_SECTORS 4
+
+// default of writing 5 seconds after the first change that isn't written yet, so a burst of
+// changes goes out as one write
+#define STATE_STORE_WRITE_DELAY 5000
+
+#include "logger.hpp"
+#include "scheduler.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * One small record kept in flash across reboots, in sectors of its own. Every write goes in the
+ * next free slot after the last one rather than over it, so a sector is only erased once every
+ * slot in it has been used, and the sectors take turns; a write that's cut short (e.g. by losing
+ * power) leaves the one before it intact.
+ *
+ * Each slot carries a sequence number, the caller's layout version and a CRC; load() takes the
+ * newest slot whose CRC holds, and only if it's of the version asked for. Saves are coalesced:
+ * the record is written STATE_STORE_WRITE_DELAY after the first save since the last write, and
+ * not at all if it's the same as what's already in flash.
+ */
+class StateStore {
+public:
+
+	// the record lives in the `sectorCount` flash sectors from `firstSector` on (at least 2), which
+	// nothing else may use
+	StateStore(Logger &logger, Scheduler &scheduler, uint32_t firstSector, int sectorCount);
+
+	// reads the newest record into data (which is zero filled past what was saved); false if
+	// there isn't one of the given version. Call it once before saving anything, since it also
+	// works out where the next write goes
+	bool load(uint16_t version, void *data, size_t size);
+	// writes the record soon, if it's changed; it's up to the caller to call this whenever it does
+	void save(uint16_t version, const void *data, size_t size);
+	// writes a save that's waiting now (e.g. before restarting)
+	void flush();
+
+	// (0 if there's no room, in which case nothing is kept)
+	int getSectorCount();
+	long getWrites();
+	long getErases();
+
+	// how a record sits in flash, and where each slot is
+	static constexpr uint32_t SLOT_MAGIC = 0x42515301;
+
+	struct Slot {
+		uint32_t magic;
+		uint32_t sequence;
+		uint16_t version, length;
+		uint8_t data[STATE_STORE_RECORD_SIZE];
+		// crc32Checksum() of everything above
+		uint32_t crc;
+	};
+
+	static_assert(sizeof(Slot) % 4 == 0, "flash is written a word at a time");
+
+	int getSlotCount();
+	uint32_t getSlotAddress(int slot);
+
+private:
+
+	Logger &logger;
+	Scheduler &scheduler;
+	uint32_t firstSector;
+	int sectorCount;
+	bool usable;
+
+	// the newest record in flash, and the slot the next one goes in
+	Slot stored;
+	bool haveStored;
+	int nextSlot;
+
+	Slot pending;
+	int writeTimer;
+
+	long writes, erases;
+
+	bool isFree(int slot);
+	void write();
+};
+
+#endif
@@ -0,0 +1,79 @@
+#include "status_cache.hpp"
+
+#include <ArduinoJson.h>
+
+StatusCache::StatusCache(BenQProjector &projector, PowerState &projectorPower) :
+	projector(projector), projectorPower(projectorPower),
+	jsonLength(0), jsonVersion(0), valid(false), serializations(0) {
+	json[0] = 0;
+
+	projector.addChangeListener([this](const ProjectorChange &change) {
+		changed();
+	});
+	projectorPower.addChangeListener([this]() {
+		changed();
+	});
+}
+
+unsigned long StatusCache::getVersion() {
+	// both only ever go up, so neither can move without the sum moving too
+	return projector.getStateVersion() + projectorPower.getStateVersion();
+}
+
+void StatusCache::addChangeListener(std::function<void()> listener) {
+	changeListeners.push_back(listener);
+}
+
+void StatusCache::changed() {
+	for (auto &listener : changeListeners) {
+		listener();
+	}
+}
+
+void StatusCache::update() {
+	unsigned long version = getVersion();
+	if (valid && version == jsonVersion) {
+		return;
+	}
+
+	auto projectorState = projector.getSnapshot();
+	auto powerState = projectorPower.getSnapshot();
+
+	StaticJsonDocument<STATUS_JSON_SIZE> status;
+
+	status["power"] = powerState.virtualPowerState;
+	status["model"] = projectorState.modelName;
+
+	if (projectorState.isOn) {
+		status["source"] = projectorState.source;
+		status["volume"] = projectorState.volume;
+		status["lamp_mode"] = projectorState.lampMode;
+	}
+
+	if (projectorState.transition != NULL) {
+		status["transition"] = projectorState.transition;
+		if (projectorState.transitionEta >= 0) {
+			// in seconds
+			status["eta"] = projectorState.transitionEta / 1000;
+		}
+	}
+
+	jsonLength = serializeJson(status, json, sizeof(json));
+	jsonVersion = version;
+	valid = true;
+	serializations++;
+}
+
+const char *StatusCache::getJson() {
+	update();
+	return json;
+}
+
+size_t StatusCache::getJsonLength() {
+	update();
+	return jsonLength;
+}
+
+long StatusCache::getSerializations() {
+	return serializations;
+}
@@ -0,0 +1,55 @@
+#ifndef STATUS_CACHE_HPP
+#define STATUS_CACHE_HPP
+
+// default status JSON buffer of 192 bytes
+#define STATUS_JSON_SIZE 192
+
+#include "projector.hpp"
+#include "power_state.hpp"
+
+#include <functional>
+#include <list>
+
+#include <stddef.h>
+
+/**
+ * The status JSON shared by everything that reports status (MQTT, HTTP's /status), built from the
+ * BenQProjector and PowerState snapshots. It's only serialized again once either of their state
+ * versions has moved on, so every consumer in between reuses the same bytes, and they can't
+ * disagree about what the status is. It's also where those consumers hear that it's moved on.
+ */
+class StatusCache {
+public:
+
+	StatusCache(BenQProjector &projector, PowerState &projectorPower);
+
+	// goes up whenever the projector's or our power state does
+	unsigned long getVersion();
+	// called whenever it goes up, as soon as it does; the status is up to date by the time the
+	// loop comes round again (a listener may be ahead of PowerState's reaction to the same change)
+	void addChangeListener(std::function<void()> listener);
+
+	// the status as of now; only valid until the next loop
+	const char *getJson();
+	size_t getJsonLength();
+
+	long getSerializations();
+
+private:
+
+	BenQProjector &projector;
+	PowerState &projectorPower;
+
+	char json[STATUS_JSON_SIZE];
+	size_t jsonLength;
+	unsigned long jsonVersion;
+	bool valid;
+	long serializations;
+
+	std::list<std::function<void()>> changeListeners;
+
+	void changed();
+	void update();
+};
+
+#endif
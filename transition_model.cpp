@@ -0,0 +1,95 @@
+#include "transition_model.hpp"
+
+TransitionModel::TransitionModel() : learned(), current(TRANSITION_NONE), startedAt(0) {
+}
+
+const TransitionModel::Learned &TransitionModel::getLearned() {
+	return learned;
+}
+
+void TransitionModel::restore(const Learned &learned) {
+	this->learned = learned;
+}
+
+void TransitionModel::start(Transition transition, unsigned long now) {
+	current = transition;
+	startedAt = now;
+}
+
+bool TransitionModel::finish(unsigned long now) {
+	if (current == TRANSITION_NONE) {
+		return false;
+	}
+
+	unsigned long took = now - startedAt;
+	uint32_t &average = current == TRANSITION_WARM_UP ? learned.warmUpMs : learned.coolDownMs;
+	uint16_t &samples = current == TRANSITION_WARM_UP ? learned.warmUpSamples : learned.coolDownSamples;
+	current = TRANSITION_NONE;
+
+	if (took < TRANSITION_MODEL_MIN_TIME || took > TRANSITION_MODEL_MAX_TIME) {
+		return false;
+	}
+
+	uint32_t previous = average;
+	average = samples == 0 ? took : (3 * average + took) / 4;
+	if (samples < UINT16_MAX) {
+		samples++;
+	}
+
+	return samples == 1 || (average > previous ? average - previous : previous - average) > 1000;
+}
+
+TransitionModel::Transition TransitionModel::getTransition() {
+	return current;
+}
+
+bool TransitionModel::getExpectedTime(Transition transition, unsigned long &expectedMs) {
+	switch (transition) {
+		case TRANSITION_WARM_UP:
+			expectedMs = learned.warmUpMs;
+			return learned.warmUpSamples > 0;
+		case TRANSITION_COOL_DOWN:
+			expectedMs = learned.coolDownMs;
+			return learned.coolDownSamples > 0;
+		default:
+			return false;
+	}
+}
+
+bool TransitionModel::getRemainingTime(unsigned long now, unsigned long &remainingMs) {
+	unsigned long expected;
+	if (!getExpectedTime(current, expected)) {
+		return false;
+	}
+
+	unsigned long elapsed = now - startedAt;
+	remainingMs = elapsed < expected ? expected - elapsed : 0;
+	return true;
+}
+
+TransitionModel::Window TransitionModel::getWindow(unsigned long now, unsigned long &opensAt) {
+	unsigned long expected;
+	if (!getExpectedTime(current, expected)) {
+		return WINDOW_UNKNOWN;
+	}
+
+	unsigned long margin = expected * TRANSITION_MODEL_WINDOW_PERCENT / 100;
+	if (margin < TRANSITION_MODEL_MIN_WINDOW) {
+		margin = TRANSITION_MODEL_MIN_WINDOW;
+	}
+
+	unsigned long elapsed = now - startedAt;
+	if (elapsed + margin < expected) {
+		opensAt = startedAt + expected - margin;
+		return BEFORE_WINDOW;
+	}
+	return elapsed <= expected + margin ? IN_WINDOW : AFTER_WINDOW;
+}
+
+int TransitionModel::getSamples(Transition transition) {
+	switch (transition) {
+		case TRANSITION_WARM_UP: return learned.warmUpSamples;
+		case TRANSITION_COOL_DOWN: return learned.coolDownSamples;
+		default: return 0;
+	}
+}
@@ -0,0 +1,78 @@
+#ifndef TRANSITION_MODEL_HPP
+#define TRANSITION_MODEL_HPP
+
+// default of only learning from warm-ups and cool-downs of 1 second to 10 minutes; anything else
+// was something other than the projector getting on with it (e.g. it lost power)
+#define TRANSITION_MODEL_MIN_TIME 1000
+#define TRANSITION_MODEL_MAX_TIME 600000
+
+// default of a window of 10% of the expected time, and at least 2 seconds, either side of when a
+// transition is expected to finish
+#define TRANSITION_MODEL_WINDOW_PERCENT 10
+#define TRANSITION_MODEL_MIN_WINDOW 2000
+
+#include <stdint.h>
+
+/**
+ * What we've learned about how long our projector takes to warm up and to cool down, and where
+ * it is in either right now. Each time one is seen from start to finish, the time it took is
+ * folded into a running average (the first one is taken as-is). Keeping what's been learned across
+ * reboots is up to the owner: finish() says when it's moved by enough (more than a second) to be
+ * worth saving, and restore() puts it back.
+ *
+ * Until a transition has been seen once, nothing is expected of it: there's no ETA and no window.
+ */
+class TransitionModel {
+public:
+
+	enum Transition {
+		TRANSITION_NONE,
+		TRANSITION_WARM_UP,
+		TRANSITION_COOL_DOWN,
+	};
+
+	// where we are relative to when the current transition is expected to finish
+	enum Window {
+		// no transition, or we don't know how long it takes
+		WINDOW_UNKNOWN,
+		BEFORE_WINDOW,
+		IN_WINDOW,
+		// later than expected; it'll finish when it finishes
+		AFTER_WINDOW,
+	};
+
+	// what's been learned, as it's saved
+	struct Learned {
+		uint32_t warmUpMs, coolDownMs;
+		uint16_t warmUpSamples, coolDownSamples;
+	};
+
+	TransitionModel();
+
+	const Learned &getLearned();
+	// takes what was learned before (e.g. before a reboot)
+	void restore(const Learned &learned);
+
+	void start(Transition transition, unsigned long now);
+	// the current transition is over; learns from it, and returns true if that's worth saving
+	bool finish(unsigned long now);
+
+	Transition getTransition();
+	// how long a transition takes, if it's been learned
+	bool getExpectedTime(Transition transition, unsigned long &expectedMs);
+	// how long until the current transition should be over (0 if it's overdue), if that's known
+	bool getRemainingTime(unsigned long now, unsigned long &remainingMs);
+	// and whether it's worth checking for the end of it yet; opensAt is set before the window
+	Window getWindow(unsigned long now, unsigned long &opensAt);
+
+	int getSamples(Transition transition);
+
+private:
+
+	Learned learned;
+
+	Transition current;
+	unsigned long startedAt;
+};
+
+#endif
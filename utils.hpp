@@ -1,33 +1,46 @@
 #ifndef UTILS_HPP
 #define UTILS_HPP
 
-#include <iomanip>
-#include <ostream>
-
-struct _FormatMillis {
-	long millis;
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A length of time in whichever of seconds, minutes or hours reads best, for printing as
+ * "%.1f %s".
+ */
+struct FormattedMillis {
+	float value;
+	const char *unit;
 };
 
-inline _FormatMillis formatMillis(long millis) {
-	return { millis };
-}
+inline FormattedMillis formatMillis(long millis) {
+	float val = millis / 1000;
+	const char *unit = "seconds";
 
-template<typename _CharT, typename _Traits> inline std::basic_ostream<_CharT, _Traits>& 
-	operator<<(std::basic_ostream<_CharT, _Traits>& os, _FormatMillis millis) { 
-		float val = millis.millis / 1000;
-		const char *unit = "seconds";
+	if (val > 60) {
+		val /= 60;
+		unit = val > 1 ? "minutes" : "minute";
+	}
 
-		if (val > 60) {
-			val /= 60;
-			unit = val > 1 ? "minutes" : "minute";
-		}
+	if (val > 90) {
+		val /= 60;
+		unit = val > 1 ? "hours" : "hour";
+	}
 
-		if (val > 90) {
-			val /= 60;
-			unit = val > 1 ? "hours" : "hour";
-		}
+	return { val, unit };
+}
 
-		return os << std::fixed << std::setprecision(1) << val << " " << unit;
+// CRC-32 (as zlib has it), a bit at a time, for where it doesn't run often
+inline uint32_t crc32Checksum(const void *data, size_t len) {
+	const uint8_t *bytes = (const uint8_t *)data;
+	uint32_t crc = 0xFFFFFFFF;
+	while (len--) {
+		crc ^= *bytes++;
+		for (int bit = 0; bit < 8; ++bit) {
+			crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+		}
 	}
+	return ~crc;
+}
 
-#endif
\ No newline at end of file
+#endif